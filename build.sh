@@ -7,6 +7,6 @@ done
 
 mkdir -p build
 
-clang++ -std=gnu++20 *.o -o build/lynx
+clang++ -std=gnu++20 -pthread *.o -o build/lynx
 
 rm *.o
@@ -2,18 +2,26 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <deque>
+#include <memory>
+#include <cstdint>
 #include <functional>
+#include <unordered_map>
+#include <unordered_set>
 
 #ifdef _WIN32
 typedef unsigned long u_long;
 #endif
 
+#define LYNX_VERSION "0.1.0"
+
 #define LYNX_LOG LYNX_LOG_TO(std::cout)
-#define LYNX_LOG_TO(_sink) _sink << "[Lynx Config] " << tokens[i].file << ":" << tokens[i].line << ":" << (tokens[i].column + 1) << ": "
+#define LYNX_LOG_TO(_sink) _sink << "[Lynx Config] " << tokens.location(i) << ": "
 
 #define LYNX_ERR LYNX_ERR_TO(std::cerr)
-#define LYNX_ERR_TO(_sink) _sink << "[Lynx Config] " << tokens[i].file << ":" << tokens[i].line << ":" << (tokens[i].column + 1) << ": "
+#define LYNX_ERR_TO(_sink) _sink << "[Lynx Config] " << tokens.location(i) << ": "
 
 #define LYNX_RT_ERR LYNX_RT_ERR_TO(std::cerr)
 #define LYNX_RT_ERR_TO(_sink) _sink << "[Lynx Config] "
@@ -29,23 +37,144 @@ enum class EntryType {
     Compound,
     Type,
     Function,
-    Any
+    Any,
+    /**
+     * A compound member that has not been evaluated yet. Compounds evaluate it before handing it out.
+     */
+    Thunk
 };
 
 std::ostream& operator<<(std::ostream& out, EntryType type);
 
+/**
+ * An interned key or identifier. Every name gets its id once and keeps it, so symbols compare and hash as integers.
+ * Converting a string to a symbol looks the name up in the global table, the id 0 is the empty name.
+ */
+struct Symbol {
+    uint32_t id = 0;
+
+    Symbol() = default;
+    /**
+     * Interns the specified name.
+     * @param name The name.
+     */
+    Symbol(std::string_view name);
+    Symbol(const std::string& name) : Symbol(std::string_view(name)) {}
+    Symbol(const char* name) : Symbol(std::string_view(name)) {}
+    /**
+     * Returns the name of this symbol.
+     */
+    const std::string& name() const;
+    /**
+     * Checks if this is the empty name.
+     */
+    bool empty() const {
+        return this->id == 0;
+    }
+
+    bool operator==(Symbol other) const {
+        return this->id == other.id;
+    }
+    bool operator!=(Symbol other) const {
+        return this->id != other.id;
+    }
+};
+
+template <>
+struct std::hash<Symbol> {
+    size_t operator()(Symbol symbol) const noexcept {
+        return symbol.id;
+    }
+};
+
+std::ostream& operator<<(std::ostream& out, Symbol symbol);
+
+/**
+ * Hands out the memory of entries and types in large chunks, which are all freed at once with the arena.
+ * Memory that is given back goes on a free list for its size and is reused by the next allocation of that size.
+ * Only the entries themselves live in the arena, the strings, lists and maps they own are still on the heap.
+ */
+struct Arena {
+    /**
+     * The arena of the parse running on this thread, or nullptr to allocate on the heap.
+     */
+    static thread_local Arena* current;
+
+    /**
+     * The number of allocations, including the ones served from a free list.
+     */
+    uint64_t allocations = 0;
+    /**
+     * The number of allocations served from a free list.
+     */
+    uint64_t reused = 0;
+    /**
+     * The number of bytes in chunks.
+     */
+    uint64_t reserved = 0;
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+    /**
+     * Allocates memory from this arena.
+     * @param size The size of the memory.
+     * @return The memory, aligned to 16 bytes.
+     */
+    void* allocate(size_t size);
+    /**
+     * Gives memory back to this arena. It must have come from this arena, or from the heap while no arena was current.
+     * @param memory The memory.
+     * @param size The size it was allocated with.
+     */
+    void release(void* memory, size_t size);
+
+private:
+    static constexpr size_t chunkSize = 64 * 1024;
+    static constexpr size_t classes = 16;
+
+    std::vector<char*> chunks;
+    char* next = nullptr;
+    char* end = nullptr;
+    void* freeLists[classes] = {};
+};
+
 struct ConfigEntry {
 private:
-    std::string key;
+    Symbol key;
     EntryType type;
 
 public:
     static ConfigEntry* Null;
+    /**
+     * The number of entries copied by clone().
+     */
+    static uint64_t clones;
+    /**
+     * The number of list and compound contents copied because they were changed while shared with a clone.
+     */
+    static uint64_t copies;
+
+    /**
+     * Allocates an entry from the current arena, or from the heap if there is none.
+     */
+    static void* operator new(size_t size);
+    /**
+     * Gives an entry back to the current arena. Only entries nothing else refers to are deleted, and only while the
+     * parse that created them is running.
+     */
+    static void operator delete(void* memory, size_t size);
 
+    virtual ~ConfigEntry() = default;
     /**
      * Returns the key of this entry.
      */
-    virtual std::string getKey() const;
+    virtual const std::string& getKey() const;
+    /**
+     * Returns the key of this entry as a symbol.
+     */
+    Symbol getSymbol() const;
     /**
      * Returns the type of this entry.
      */
@@ -54,7 +183,7 @@ public:
      * Sets the key of this entry.
      * @param key The key to set.
      */
-    virtual void setKey(const std::string& key);
+    virtual void setKey(Symbol key);
     /**
      * Sets the type of this entry.
      * @param type The type to set.
@@ -62,6 +191,8 @@ public:
     virtual void setType(EntryType type);
     /**
      * Creates a copy of this entry.
+     * Lists and compounds share their contents with the copy until one of them is changed, so copying them takes
+     * the same time whatever their size.
      * @return A copy of this entry.
      */
     virtual ConfigEntry* clone() = 0;
@@ -94,12 +225,18 @@ public:
      * Returns the value of this entry.
      * @return The value of this entry.
      */
-    std::string getValue() const;
+    const std::string& getValue() const;
     /**
      * Sets the value of this entry.
      * @param value The value to set.
      */
     void setValue(std::string value);
+    /**
+     * Appends to the value of this entry. The value grows in place, so building a string from many parts takes time
+     * linear in its final length.
+     * @param value The value to append.
+     */
+    void append(std::string_view value);
     /**
      * Checks if this entry is empty.
      * @return True if this entry is empty, false otherwise.
@@ -175,12 +312,21 @@ public:
 };
 
 struct CompoundEntry;
+struct FrozenConfig;
 
 struct ListEntry : public ConfigEntry {
 private:
-    std::vector<ConfigEntry*> values;
+    /**
+     * The values, shared with clones of this list until one of them changes. nullptr while the list is empty.
+     */
+    std::shared_ptr<std::vector<ConfigEntry*>> values;
     EntryType listType = EntryType::Invalid;
 
+    /**
+     * Returns the values for changing them, copying them first if a clone still shares them.
+     */
+    std::vector<ConfigEntry*>& detach();
+
 public:
     /**
      * Creates a new list entry.
@@ -225,6 +371,11 @@ public:
      * @param value The value to add.
      */
     void add(ConfigEntry* value);
+    /**
+     * Makes room for a number of values, so adding or merging up to that many does not grow the list again.
+     * @param size The number of values the list will hold.
+     */
+    void reserve(unsigned long size);
     /**
      * Removes the value at the specified index.
      * @param index The index of the value to remove.
@@ -278,11 +429,119 @@ public:
     void print(std::ostream& stream, int indent = 0) const override;
 };
 
+/**
+ * The entries of a compound, kept in the order they were first added. Small maps are searched linearly, larger ones
+ * also keep an open-addressing index from keys to positions.
+ */
+struct EntryMap {
+    struct Member {
+        Symbol key;
+        ConfigEntry* value;
+    };
+
+    /**
+     * Maps with more members than this get an index.
+     */
+    static constexpr size_t linearLimit = 8;
+
+    /**
+     * Returns the entry with the specified key.
+     * @param key The key of the entry.
+     * @return The entry, or nullptr if there is none.
+     */
+    ConfigEntry* find(Symbol key) const {
+        if (this->index.empty()) {
+            for (const Member& member : this->members) {
+                if (member.key == key) {
+                    return member.value;
+                }
+            }
+            return nullptr;
+        }
+        size_t at = this->position(key);
+        return at < this->members.size() ? this->members[at].value : nullptr;
+    }
+    /**
+     * Returns the entry with the specified key, adding a nullptr entry at the end if there is none. The reference is
+     * only valid until the next member is added.
+     * @param key The key of the entry.
+     * @return The entry.
+     */
+    ConfigEntry*& operator[](Symbol key);
+    /**
+     * Removes the entry with the specified key, keeping the order of the others.
+     * @param key The key of the entry.
+     */
+    void erase(Symbol key);
+    /**
+     * Replaces the entry with the specified key, keeping its position. Nothing happens if there is none.
+     * @param key The key of the entry.
+     * @param value The new entry.
+     */
+    void replace(Symbol key, ConfigEntry* value);
+    /**
+     * Makes room for a number of members.
+     * @param size The number of members the map will hold.
+     */
+    void reserve(size_t size);
+    size_t size() const {
+        return this->members.size();
+    }
+    bool empty() const {
+        return this->members.empty();
+    }
+    std::vector<Member>::const_iterator begin() const {
+        return this->members.begin();
+    }
+    std::vector<Member>::const_iterator end() const {
+        return this->members.end();
+    }
+
+private:
+    std::vector<Member> members;
+    /**
+     * The positions of the members plus one by hashed key, 0 for a free slot. Empty while the map is small.
+     */
+    std::vector<uint32_t> index;
+    uint32_t shift = 0;
+
+    /**
+     * Returns the position of the member with the specified key, or size() if there is none.
+     */
+    size_t position(Symbol key) const;
+    void insert(size_t position);
+    void rebuild(size_t size);
+};
+
 struct CompoundEntry : public ConfigEntry {
 private:
-    std::unordered_map<std::string, ConfigEntry*> entriesMap;
+    /**
+     * The entries, shared with clones of this compound until one of them changes. nullptr while the compound is
+     * empty.
+     */
+    std::shared_ptr<EntryMap> entriesMap;
+
+    /**
+     * Returns the entries for changing them, copying them first if a clone still shares them.
+     */
+    EntryMap& detach();
+    /**
+     * Evaluates a deferred member and puts its value in its place, in every compound sharing the entries.
+     * @return The value, or nullptr if it failed to evaluate.
+     */
+    ConfigEntry* evaluate(ConfigEntry* thunk) const;
 
 public:
+    /**
+     * Changes every time an entry is added or removed. No two compounds ever share a version.
+     */
+    uint64_t version;
+    /**
+     * Set on compounds that stay as they are for as long as the parser does, the root and the members of other such
+     * compounds. Only their members are deferred, the others may be freed before the values would be evaluated.
+     */
+    bool lasting = false;
+
     /**
      * Creates a new compound entry.
      */
@@ -292,13 +551,19 @@ public:
      * @param key The key of the entry to get.
      * @return The entry with the specified key.
      */
-    bool hasMember(const std::string& key) const;
+    bool hasMember(Symbol key) const;
     /**
      * Returns the entry with the specified key.
      * @param key The key of the entry to get.
      * @return The entry with the specified key.
      */
-    ConfigEntry* get(const std::string& key) const;
+    ConfigEntry* get(Symbol key) const;
+    /**
+     * Returns the entry with the specified key without evaluating it if it was deferred.
+     * @param key The key of the entry to get.
+     * @return The entry, or nullptr if there is none.
+     */
+    ConfigEntry* peek(Symbol key) const;
     /**
      * Returns the entry with the specified dot-separated path.
      * @param path The path of the entry to get.
@@ -310,38 +575,38 @@ public:
      * @param key The key of the entry to get.
      * @return The entry with the specified key.
      */
-    ConfigEntry*& operator[](const std::string& key);
+    ConfigEntry*& operator[](Symbol key);
     /**
      * Returns the string entry with the specified key.
      * @param key The key of the entry to get.
      * @return The string entry with the specified key.
      */
-    StringEntry* getString(const std::string& key) const;
+    StringEntry* getString(Symbol key) const;
     /**
      * Returns the string entry with the specified key or the default value if the entry does not exist.
      * @param key The key of the entry to get.
      * @param defaultValue The default value to return if the entry does not exist.
      * @return The string entry with the specified key or the default value if the entry does not exist.
      */
-    StringEntry* getStringOrDefault(const std::string& key, const std::string& defaultValue);
+    StringEntry* getStringOrDefault(Symbol key, const std::string& defaultValue);
     /**
      * Returns the list entry with the specified key.
      * @param key The key of the entry to get.
      * @return The list entry with the specified key.
      */
-    ListEntry* getList(const std::string& key) const;
+    ListEntry* getList(Symbol key) const;
     /**
      * Returns the compound entry with the specified key.
      * @param key The key of the entry to get.
      * @return The compound entry with the specified key.
      */
-    CompoundEntry* getCompound(const std::string& key) const;
+    CompoundEntry* getCompound(Symbol key) const;
     /**
      * Returns the number entry with the specified key.
      * @param key The key of the entry to get.
      * @return The number entry with the specified key.
      */
-    NumberEntry* getNumber(const std::string& key) const;
+    NumberEntry* getNumber(Symbol key) const;
     /**
      * Adds an entry to the compound entry.
      * If an entry with the same key already exists, it will be replaced.
@@ -353,25 +618,25 @@ public:
      * @param key The key of the entry to set.
      * @param value The value to set.
      */
-    void setString(const std::string& key, const std::string& value);
+    void setString(Symbol key, const std::string& value);
     /**
      * Adds a string entry with the specified key.
      * @param key The key of the entry to add.
      * @param value The value to add.
      */
-    void addString(const std::string& key, const std::string& value);
+    void addString(Symbol key, const std::string& value);
     /**
      * Adds a list entry with the specified key.
      * @param key The key of the entry to add.
      * @param value The value to add.
      */
-    void addList(const std::string& key, const std::vector<ConfigEntry*>& value);
+    void addList(Symbol key, const std::vector<ConfigEntry*>& value);
     /**
      * Adds a list entry with the specified key.
      * @param key The key of the entry to add.
      * @param value The value to add.
      */
-    void addList(const std::string& key, ConfigEntry* value);
+    void addList(Symbol key, ConfigEntry* value);
     /**
      * Adds a list entry with the specified key.
      * @param key The key of the entry to add.
@@ -388,11 +653,16 @@ public:
      * Removes the entry with the specified key.
      * @param key The key of the entry to remove.
      */
-    void remove(const std::string& key);
+    void remove(Symbol key);
     /**
      * Removes all entries from the compound entry.
      */
     void removeAll();
+    /**
+     * Makes room for a number of entries.
+     * @param size The number of entries the compound will hold.
+     */
+    void reserve(size_t size);
     /**
      * Checks if the compound entry is empty.
      * @return True if the compound entry is empty, false otherwise.
@@ -404,6 +674,26 @@ public:
      * @return The number of entries that were merged.
      */
     size_t merge(CompoundEntry* other);
+    /**
+     * Checks if this compound shares its entries with another one, as a copy does until one of them changes.
+     * @param other The other compound.
+     * @return True if they share their entries.
+     */
+    bool shares(const CompoundEntry* other) const;
+    /**
+     * Checks if none of the members of this compound is still deferred, without evaluating them.
+     * @return True if all members have been evaluated.
+     */
+    bool isEvaluated() const;
+    /**
+     * Returns the entries of this compound in the order they were added, evaluating the deferred ones first.
+     */
+    const EntryMap& getEntries() const;
+    /**
+     * Copies this compound and everything in it into a read-only image.
+     * @return The image.
+     */
+    FrozenConfig* freeze() const;
     /**
      * Creates a copy of this entry.
      * @return A copy of this entry.
@@ -429,8 +719,295 @@ public:
     void print(std::ostream& stream, int indent = 0) const override;
 };
 
+/**
+ * An entry of a frozen config. It is only a position in the image, so it is passed by value and stays valid as long
+ * as the image does. Looking up something that is not there returns an entry that does not exist.
+ */
+struct FrozenEntry {
+    const FrozenConfig* config = nullptr;
+    uint32_t node = 0;
+
+    /**
+     * Checks if this entry exists.
+     */
+    bool exists() const {
+        return this->config != nullptr;
+    }
+    /**
+     * Returns the type of this entry, Invalid if it does not exist.
+     */
+    EntryType getType() const;
+    /**
+     * Returns the key of this entry, empty for list values.
+     */
+    std::string_view getKey() const;
+    /**
+     * Returns the value of a number entry.
+     * @return The value, 0 if this is not a number.
+     */
+    double getNumber() const;
+    /**
+     * Returns the value of a string entry.
+     * @return The value, empty if this is not a string.
+     */
+    std::string_view getString() const;
+    /**
+     * Returns the number of values of a list or entries of a compound.
+     */
+    size_t size() const;
+    /**
+     * Returns the value of a list or the entry of a compound at the specified position.
+     * @param index The position, compound entries are in the order they were added.
+     * @return The entry.
+     */
+    FrozenEntry operator[](size_t index) const;
+    /**
+     * Returns the entry of a compound with the specified key.
+     * @param key The key.
+     * @return The entry.
+     */
+    FrozenEntry get(std::string_view key) const;
+    /**
+     * Returns the entry with the specified dot-separated path below this compound.
+     * @param path The path.
+     * @return The entry.
+     */
+    FrozenEntry getByPath(std::string_view path) const;
+    /**
+     * Prints this entry like the entry it was frozen from.
+     * @param stream The output stream to print to.
+     * @param indent The indentation level.
+     */
+    void print(std::ostream& stream, int indent = 0) const;
+};
+
+/**
+ * A read-only copy of an evaluated config in one contiguous block of memory, made by CompoundEntry::freeze.
+ * The block holds a header, the entries as fixed size nodes, the hash tables of the larger compounds, the string
+ * table and the characters of the strings. The members of a list or compound are next to each other and come before
+ * the members of their members, equal strings are stored once. Positions in the block are offsets, nothing in it
+ * points to memory outside of it. The image never changes after it is built, so any number of threads can read it
+ * without locking.
+ */
+struct FrozenConfig {
+    /**
+     * Compounds with at most this many entries are searched linearly instead of through a hash table.
+     */
+    static constexpr uint32_t linearLimit = 8;
+
+    struct Header {
+        uint32_t nodes;
+        uint32_t slots;
+        uint32_t strings;
+        uint32_t chars;
+    };
+
+    struct Node {
+        EntryType type;
+        /**
+         * The string of the key.
+         */
+        uint32_t key;
+        union {
+            double number;
+            struct {
+                /**
+                 * The first member node of a list or compound, the string of a string, function or type.
+                 */
+                uint32_t first;
+                uint32_t count;
+            };
+        };
+    };
+
+    /**
+     * A slot of the hash table of a compound, open addressing with linear probing. The first slot of a table holds
+     * its mask in node.
+     */
+    struct Slot {
+        /**
+         * The member node plus one, 0 for a free slot.
+         */
+        uint32_t node;
+        /**
+         * The upper half of the hash of the key, so most other keys are skipped without reading their strings.
+         */
+        uint32_t hash;
+    };
+
+    struct String {
+        uint64_t hash;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    /**
+     * Takes over an image.
+     * @param image The image, as built by CompoundEntry::freeze.
+     */
+    FrozenConfig(std::vector<char> image);
+    FrozenConfig(const FrozenConfig&) = delete;
+    FrozenConfig& operator=(const FrozenConfig&) = delete;
+    ~FrozenConfig();
+    /**
+     * Returns the root compound.
+     */
+    FrozenEntry root() const {
+        return {this, 0};
+    }
+    /**
+     * Returns the bytes of the image.
+     */
+    const char* data() const {
+        return this->bytes;
+    }
+    /**
+     * Returns the size of the image in bytes.
+     */
+    size_t size() const {
+        return this->length;
+    }
+    /**
+     * Writes the image to a file, behind a header with the format version, the byte order and the path of the
+     * source. The file is written next to the path and renamed into place, so readers never see a partial file.
+     * @param path The path of the file.
+     * @param source The path of the file the image was evaluated from.
+     * @return True if the file was written.
+     */
+    bool write(const std::string& path, const std::string& source) const;
+    /**
+     * Loads an image written by write(). The file is mapped into memory and queried in place, nothing is copied or
+     * decoded, and processes that load the same file share its pages. Every index in the image is checked against
+     * the section it points into, a damaged image is refused instead of read out of bounds.
+     * @param path The path of the file.
+     * @return The image, or nullptr if the file could not be read or is not a valid image of this format.
+     */
+    static FrozenConfig* load(const std::string& path);
+    /**
+     * Reads the path of the file an image was written from, which can be parsed instead if the image is damaged.
+     * @param path The path of the image.
+     * @return The path, or an empty string if the file is not an image of this format.
+     */
+    static std::string source(const std::string& path);
+    /**
+     * Checks if a file starts like an image written by write().
+     * @param path The path of the file.
+     */
+    static bool isImage(const std::string& path);
+    /**
+     * Hashes a key like the compound tables do.
+     */
+    static uint64_t hash(std::string_view key);
+
+private:
+    friend struct FrozenEntry;
+
+    /**
+     * The image, unless it is mapped.
+     */
+    std::vector<char> buffer;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    const char* bytes = nullptr;
+    size_t length = 0;
+    const Node* nodes = nullptr;
+    /**
+     * Parallel to the nodes, the first slot of the table of a compound with more than linearLimit entries.
+     */
+    const uint32_t* tables = nullptr;
+    const Slot* slots = nullptr;
+    const String* strings = nullptr;
+    const char* chars = nullptr;
+
+    FrozenConfig() = default;
+    /**
+     * Points the sections at an image and checks every index in them.
+     * @return False if the sizes in its header do not add up to its size, or an index is out of bounds.
+     */
+    bool attach(const char* bytes, size_t length);
+    /**
+     * Checks the hash table of a compound node, whose members have already been checked.
+     * @param at The node.
+     * @param slots The number of slots in the image.
+     * @return False if the table does not fit in the slots, points outside the members or has no free slot.
+     */
+    bool checkTable(uint32_t at, uint32_t slots) const;
+
+    std::string_view string(uint32_t id) const {
+        return std::string_view(this->chars + this->strings[id].offset, this->strings[id].length);
+    }
+};
+
+inline EntryType FrozenEntry::getType() const {
+    return this->config ? this->config->nodes[this->node].type : EntryType::Invalid;
+}
+
+inline std::string_view FrozenEntry::getKey() const {
+    return this->config ? this->config->string(this->config->nodes[this->node].key) : std::string_view();
+}
+
+inline double FrozenEntry::getNumber() const {
+    return this->getType() == EntryType::Number ? this->config->nodes[this->node].number : 0;
+}
+
+inline std::string_view FrozenEntry::getString() const {
+    return this->getType() == EntryType::String ? this->config->string(this->config->nodes[this->node].first) : std::string_view();
+}
+
+inline size_t FrozenEntry::size() const {
+    EntryType type = this->getType();
+    return type == EntryType::List || type == EntryType::Compound ? this->config->nodes[this->node].count : 0;
+}
+
+inline FrozenEntry FrozenEntry::operator[](size_t index) const {
+    if (index >= this->size()) {
+        return {};
+    }
+    return {this->config, (uint32_t) (this->config->nodes[this->node].first + index)};
+}
+
+/**
+ * A dotted path that is looked up on compound stacks, split into its keys once.
+ * Remembers how deep in the stack it was found and which compounds it went through, so a lookup on a stack whose
+ * compounds have not changed since goes straight to the entry. Scopes above the entry are searched from the top
+ * down like before, so a name bound in a newer scope still shadows the cached one.
+ */
+struct ScopePath {
+    struct Scope {
+        const CompoundEntry* compound;
+        uint64_t version;
+    };
+
+    std::string path;
+    std::vector<Symbol> keys;
+    /**
+     * The scopes that did not contain the path at the last lookup, from the top of the stack down.
+     */
+    std::vector<Scope> misses;
+    /**
+     * The compounds the last lookup went through, starting with the scope the entry was found in.
+     */
+    std::vector<Scope> chain;
+    /**
+     * The entry found by the last lookup, at depth misses.size() from the top of the stack, or nullptr.
+     */
+    ConfigEntry* entry = nullptr;
+
+    /**
+     * Creates a path.
+     * @param path The dot-separated path.
+     */
+    ScopePath(const std::string& path = "");
+    /**
+     * Finds the entry with this path in the topmost compound of the stack that has it.
+     * @param compoundStack The compound stack.
+     * @return The entry, or nullptr if no compound has it.
+     */
+    ConfigEntry* find(const std::vector<CompoundEntry*>& compoundStack);
+};
+
 struct Token {
-    enum {
+    enum : uint8_t {
         Invalid,
         String,         // "string"
         Number,         // 123.456
@@ -445,35 +1022,332 @@ struct Token {
         Is,             // :
         Assign,         // =
     } type;
-    std::string value;
-    std::string file;
-    int line;
-    int column;
+    enum : uint8_t {
+        Decoded = 1,    // value lives in SourceFile::strings instead of SourceFile::data
+    };
+    uint8_t flags;
+    uint32_t file;
+    uint32_t offset;
+    uint32_t length;
+    /**
+     * The name of an identifier, interned when the token is lexed.
+     */
+    Symbol symbol;
 
     bool operator==(const Token& other) const;
     bool operator!=(const Token& other) const;
 };
 
+struct SourceLocation {
+    const std::string* file;
+    uint32_t line;
+    uint32_t column;
+};
+
+std::ostream& operator<<(std::ostream& out, const SourceLocation& location);
+
+struct SourceFile {
+    struct Escape {
+        uint32_t offset;
+        uint32_t start;
+        uint32_t length;
+    };
+
+    std::string path;
+    /**
+     * The contents of the file. Points into the memory mapping, or into buffer if the file could not be mapped.
+     */
+    std::string_view data;
+    std::string buffer;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    /**
+     * Decoded string literals that contained escape sequences.
+     */
+    std::string strings;
+    /**
+     * Where to find the decoded value of each string token flagged as Token::Decoded, sorted by token offset.
+     */
+    std::vector<Escape> escapes;
+    /**
+     * Offset of the first character of every line in data.
+     */
+    std::vector<uint32_t> lines;
+
+    /**
+     * Returns the line and column of the specified offset in data.
+     * @param offset The offset to locate.
+     * @return The location of the offset.
+     */
+    SourceLocation locate(uint32_t offset) const;
+
+    SourceFile() = default;
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+    ~SourceFile();
+};
+
+struct SourceTable {
+    std::deque<SourceFile> files;
+
+    /**
+     * Adds a file to the table.
+     * @param path The path of the file.
+     * @param data The contents of the file.
+     * @return The id of the file.
+     */
+    uint32_t add(const std::string& path, std::string data);
+    /**
+     * Maps the specified file into memory and adds it to the table.
+     * Falls back to reading the file if it cannot be mapped.
+     * @param path The path of the file.
+     * @return The id of the file, or -1 if the file could not be opened.
+     */
+    int64_t load(const std::string& path);
+    /**
+     * Returns the text of the specified token.
+     * @param token The token.
+     * @return A view of the token text.
+     */
+    std::string_view text(const Token& token) const;
+    /**
+     * Returns the location of the specified token.
+     * @param token The token.
+     * @return The location of the token.
+     */
+    SourceLocation location(const Token& token) const;
+};
+
+/**
+ * Lexes the tokens of a whole file on demand, wrapped in '{' and '}' like the root compound.
+ * Only a small window of recently used tokens is kept, so memory does not grow with the size of the file.
+ */
+struct TokenStream {
+    static constexpr size_t Lookbehind = 32;
+
+    SourceTable* sources;
+    uint32_t file;
+    int64_t position = 0;
+    bool started = false;
+    bool done = false;
+    bool failed = false;
+    /**
+     * The tokens that are still reachable. window[0] is the token with index base.
+     */
+    std::deque<Token> window;
+    size_t base = 0;
+    size_t highest = 0;
+    /**
+     * Indices that must stay in the window until they are unpinned.
+     */
+    std::vector<size_t> pins;
+    /**
+     * Tokens in the packed form used by the parse cache.
+     * When replaying, tokens are read from here instead of being lexed. When recording, lexed tokens are appended.
+     */
+    std::string packed;
+    size_t packedPosition = 0;
+    uint32_t packedOffset = 0;
+    bool replaying = false;
+    bool recording = false;
+
+    TokenStream(SourceTable* sources, uint32_t file);
+    /**
+     * Lexes tokens until the token with the specified index is available.
+     * @param index The index of the token.
+     * @return True if the token exists, false if the file ended before it.
+     */
+    bool fill(size_t index);
+    /**
+     * Returns the token with the specified index, lexing it if needed.
+     * @param index The index of the token.
+     * @return The token, or an Invalid token if it does not exist.
+     */
+    const Token& at(size_t index);
+};
+
+struct Node;
+
+/**
+ * The tokens of a stored list, shared by all of its slices, together with what has been compiled from them.
+ */
+struct TokenStorage {
+    std::vector<Token> tokens;
+    /**
+     * The node compiled from each token, filled in the first time an expression starting there is evaluated.
+     */
+    std::vector<std::unique_ptr<Node>> nodes;
+    /**
+     * The index of the matching block end for each block start that has been captured, 0 if unknown.
+     */
+    std::vector<uint32_t> blockEnds;
+};
+
+struct TokenList {
+private:
+    std::shared_ptr<TokenStorage> storage;
+    std::shared_ptr<TokenStream> stream;
+    size_t begin;
+    size_t end;
+
+public:
+    SourceTable* sources;
+
+    /**
+     * Creates a new, empty token list.
+     * @param sources The file table the tokens refer to.
+     */
+    TokenList(SourceTable* sources = nullptr);
+    /**
+     * Creates a token list that pulls its tokens from a stream.
+     * @param stream The stream.
+     */
+    TokenList(std::shared_ptr<TokenStream> stream);
+    /**
+     * Checks if the token with the specified index exists.
+     * On a streaming list this lexes up to the token.
+     * @param index The index of the token.
+     * @return True if the token exists.
+     */
+    bool has(size_t index) const;
+    /**
+     * Returns the number of tokens in the list.
+     * On a streaming list this lexes the rest of the file, prefer has().
+     */
+    size_t size() const;
+    /**
+     * Checks if the list is empty.
+     */
+    bool empty() const;
+    /**
+     * Returns the token at the specified index.
+     * @param index The index of the token.
+     * @return The token at the specified index.
+     */
+    const Token& operator[](size_t index) const;
+    /**
+     * Adds a token to the end of the list.
+     * @param token The token to add.
+     */
+    void push_back(const Token& token);
+    /**
+     * Returns a list with the tokens in the range [from, to).
+     * Slices of a stored list share its tokens, slices of a streaming list are copied out of the window.
+     * @param from The index of the first token.
+     * @param to The index after the last token.
+     * @return The slice.
+     */
+    TokenList slice(size_t from, size_t to) const;
+    /**
+     * Keeps a streaming list from dropping the tokens from the specified index on until unpin() is called.
+     * @param index The index of the first token to keep.
+     */
+    void pin(size_t index) const;
+    /**
+     * Removes the most recent pin.
+     */
+    void unpin() const;
+    /**
+     * Returns the text of the token at the specified index.
+     * @param index The index of the token.
+     * @return A view of the token text.
+     */
+    std::string_view value(size_t index) const;
+    /**
+     * Returns the location of the token at the specified index.
+     * If the index is past the end, the location of the last token is returned.
+     * @param index The index of the token.
+     * @return The location of the token.
+     */
+    SourceLocation location(size_t index) const;
+    /**
+     * Returns the slot for the node compiled from the token at the specified index.
+     * Slots belong to the shared tokens, so every slice and copy of a stored list sees the same nodes.
+     * @param index The index of the token.
+     * @return The slot, or nullptr on a streaming list, which does not keep nodes.
+     */
+    std::unique_ptr<Node>* node(size_t index) const;
+    /**
+     * Returns the index of the block end matching the block start at the specified index.
+     * If the block is not closed, the index of the last token is returned. Stored lists remember the result.
+     * @param index The index of the block start.
+     * @return The index of the block end.
+     */
+    size_t blockEnd(size_t index) const;
+
+    bool operator==(const TokenList& other) const;
+    bool operator!=(const TokenList& other) const;
+};
+
 struct Type {
     struct CompoundType {
-        std::string key;
+        Symbol key;
         Type* type;
 
         bool operator==(const CompoundType& other) const;
         bool operator!=(const CompoundType& other) const;
     };
+
+    /**
+     * One step of a compiled validator. The members of a compound are checked by consecutive steps, which come after
+     * the step of the compound, and so does the step for the elements of a list.
+     */
+    struct Check {
+        EntryType type;
+        bool isOptional;
+        /**
+         * The key of the member this step checks, if it checks one.
+         */
+        Symbol key;
+        /**
+         * The step for the elements of a list or the first member of a compound.
+         */
+        uint32_t next;
+        /**
+         * The number of members of a compound.
+         */
+        uint32_t count;
+    };
     
+private:
+    Type() = default;
+
+public:
     EntryType type;
     Type* listType;
     std::vector<CompoundType>* compoundTypes;
     bool isOptional = false;
+    /**
+     * The validator, compiled when the type is interned.
+     */
+    Check* checks = nullptr;
 
+    /**
+     * Checks that an entry has this type, including every element of a list and every member of a compound.
+     * Long lists of lists or compounds are checked on several threads. Nothing is built unless there is an error.
+     * @param what The entry to check.
+     * @param flags The flags, "optional" allows any member of a compound to be missing.
+     * @param out The stream to report errors to.
+     * @return True if the entry has this type.
+     */
     virtual bool validate(ConfigEntry* what, const std::vector<std::string>& flags, std::ostream& out = std::cout);
-    Type* clone();
+    /**
+     * Compares types. Types are interned, so this compares their addresses.
+     */
     bool operator==(const Type& other) const;
     bool operator!=(const Type& other) const;
     std::string toString() const;
 
+    /**
+     * Returns the type with the specified structure. Types are interned, equal types are the same object, which is
+     * never changed and lives until the program exits.
+     * @param type The type of the entries it matches.
+     * @param listType The type of the elements, for a list.
+     * @param compoundTypes The members, for a compound or the arguments, for a function.
+     * @param isOptional Whether the type is optional.
+     * @return The interned type.
+     */
+    static Type* get(EntryType type, Type* listType = nullptr, const std::vector<CompoundType>& compoundTypes = {}, bool isOptional = false);
     static Type* String();
     static Type* Number();
     static Type* List(Type* type);
@@ -481,30 +1355,152 @@ struct Type {
     static Type* Function(std::vector<CompoundType> types);
     static Type* Optional(Type* type);
     static Type* Any();
+
+private:
+    /**
+     * Compiles the validator of this type into a flat list of steps.
+     */
+    void compile();
 };
 
 struct ConfigParser;
+struct NativeFunctionEntry;
+struct ThunkEntry;
+
+/**
+ * The arguments of a call, in the order the function declares them. Frames of up to inlineSize arguments are kept in
+ * the frame itself, so a call site can keep them on its stack.
+ */
+struct ArgFrame {
+    static constexpr size_t inlineSize = 8;
+
+    ConfigEntry* inlined[inlineSize];
+    std::vector<ConfigEntry*> spilled;
+    ConfigEntry** values;
+
+    /**
+     * Creates a frame of empty arguments.
+     * @param arity The number of arguments.
+     */
+    ArgFrame(size_t arity);
+    ArgFrame(const ArgFrame&) = delete;
+    ArgFrame& operator=(const ArgFrame&) = delete;
+};
 
 struct FunctionEntry : public ConfigEntry {
     std::vector<Type::CompoundType> args;
-    std::vector<Token> body;
+    TokenList body;
     bool isDotCallable;
 
     FunctionEntry();
-    CompoundEntry* parseArgs(ConfigParser* parser, std::vector<Token>& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
+    /**
+     * Parses the arguments of a call into a frame. Named arguments go to the position of their name, and every
+     * argument is checked against the type of its position.
+     * @param parser The parser.
+     * @param tokens The tokens of the call.
+     * @param i The index of the function name, set to the last token of the arguments.
+     * @param compoundStack The compound stack of the caller.
+     * @param args The frame, with room for as many arguments as the function takes.
+     * @return False on error.
+     */
+    bool parseArgs(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args);
+    /**
+     * Finds the position of a named argument.
+     * @param name The name.
+     * @return The index of the argument, or the number of arguments if the function has none by that name.
+     */
+    size_t position(Symbol name) const;
+    /**
+     * Checks the type of an argument and puts it into its position in a frame.
+     * @param tokens The tokens of the call, for errors.
+     * @param i The index of the last token of the argument.
+     * @param position The index of the argument.
+     * @param arg The argument.
+     * @param args The frame.
+     * @return False if the type is invalid or the position was already taken.
+     */
+    bool bindArg(TokenList& tokens, int i, size_t position, ConfigEntry* arg, ConfigEntry** args);
+    /**
+     * Builds the compound the body of the function sees its arguments in.
+     * @param args The arguments.
+     * @return The compound.
+     */
+    CompoundEntry* makeScope(ConfigEntry** args) const;
     bool operator==(const ConfigEntry& other) override;
     bool operator!=(const ConfigEntry& other) override;
     void print(std::ostream& stream, int indent = 0) const override;
     ConfigEntry* clone() override;
-    virtual ConfigEntry* call(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, std::vector<Token>& tokens, int& i);
+    ConfigEntry* call(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, TokenList& tokens, int& i);
+    /**
+     * Runs the function with arguments that have already been bound and validated. The function takes the arguments.
+     * @param parser The parser.
+     * @param compoundStack The compound stack of the caller.
+     * @param args The arguments, in the order the function declares them.
+     * @return The result, or nullptr on error.
+     */
+    virtual ConfigEntry* invoke(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args);
+};
+
+/**
+ * The results of earlier calls of a declared function, kept if its body calls nothing with side effects.
+ * A result is reused for arguments that are equal to the ones it was computed for, as long as none of the compounds
+ * the paths in the body, and in the bodies of the functions they name, are looked up in has changed.
+ */
+struct FunctionMemo {
+    struct Call {
+        /**
+         * Copies of the arguments, in the order the function declares them.
+         */
+        std::vector<ConfigEntry*> args;
+        /**
+         * The versions of the compounds the paths were looked up in when the result was computed.
+         */
+        std::vector<uint64_t> names;
+        ConfigEntry* result;
+    };
+
+    /**
+     * The number of results kept per function. The oldest ones are dropped all at once when there are more.
+     */
+    static constexpr size_t limit = 4096;
+    /**
+     * Functions that have been called this many times with new arguments are no longer memoized, unless at least a
+     * quarter of their calls reused a result.
+     */
+    static constexpr uint64_t trial = 512;
+
+    /**
+     * False if the body calls a native function with side effects or uses set.
+     */
+    bool pure = true;
+    /**
+     * The paths in the body that are looked up when it runs, except the ones naming builtins and native functions.
+     */
+    std::vector<ScopePath> paths;
+    /**
+     * The calls by the hash of their arguments.
+     */
+    std::unordered_multimap<uint64_t, Call> calls;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    /**
+     * Finds the paths in the body of a function.
+     * @param function The function.
+     */
+    FunctionMemo(const FunctionEntry& function);
 };
 
 struct DeclaredFunctionEntry : public FunctionEntry {
     std::vector<CompoundEntry*> compoundStack;
+    /**
+     * The results of earlier calls, shared with the copies of this function. nullptr until it is first called.
+     */
+    std::shared_ptr<FunctionMemo> memo;
 
     DeclaredFunctionEntry();
     ConfigEntry* clone() override;
-    ConfigEntry* call(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, std::vector<Token>& tokens, int& i) override;
+    ConfigEntry* invoke(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) override;
 };
 
 struct TypeEntry : public ConfigEntry {
@@ -518,26 +1514,292 @@ struct TypeEntry : public ConfigEntry {
     ConfigEntry* clone() override;
 };
 
-using BuiltinCommand = std::function<ConfigEntry*(std::vector<Token>&, int&, ConfigParser*, std::vector<CompoundEntry*>&)>;
+using BuiltinCommand = ConfigEntry* (*)(TokenList&, int&, ConfigParser*, std::vector<CompoundEntry*>&);
+
+/**
+ * Looks up a builtin by name in a table indexed by symbol id.
+ * @param name The name.
+ * @return The builtin, or nullptr if there is none with that name.
+ */
+BuiltinCommand findBuiltin(Symbol name);
+/**
+ * Looks up a native function by name in a table indexed by symbol id.
+ * @param name The name.
+ * @return The function, or nullptr if there is none with that name.
+ */
+NativeFunctionEntry* findNative(Symbol name);
+
+/**
+ * An expression compiled from the token it starts at. Literals are decoded, paths are joined and builtins and
+ * native functions are looked up once, when the node is created.
+ * How many tokens a call takes depends on the function it finds at runtime, so nodes only describe their first
+ * token and evaluate the rest of the expression as they run.
+ */
+struct Node {
+    virtual ~Node() = default;
+    /**
+     * Evaluates the expression.
+     * @param parser The parser.
+     * @param tokens The tokens the node was compiled from.
+     * @param i The index of the first token of the expression, set to the index of its last token.
+     * @param compoundStack The compound stack.
+     * @return The value of the expression, or nullptr on error.
+     */
+    virtual ConfigEntry* eval(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) = 0;
+};
+
+/**
+ * Stores the tokens of parsed files in a directory, keyed by a hash of the file contents and the lynx version.
+ * Entries are written to a temporary file and renamed into place, so several processes can share a directory.
+ */
+struct ParseCache {
+    std::string directory;
+    size_t hits = 0;
+    size_t misses = 0;
+
+    /**
+     * Creates a cache in the specified directory. The directory is created when the first entry is stored.
+     * @param directory The cache directory.
+     */
+    ParseCache(const std::string& directory);
+    /**
+     * Looks up the specified file and sets the stream up to replay its cached tokens.
+     * @param sources The file table.
+     * @param file The id of the file.
+     * @param stream The stream of the file.
+     * @return True on a hit, false if the file has to be lexed.
+     */
+    bool load(SourceTable* sources, uint32_t file, TokenStream& stream);
+    /**
+     * Stores the tokens a stream recorded while lexing the specified file.
+     * @param sources The file table.
+     * @param file The id of the file.
+     * @param stream The stream of the file.
+     */
+    void store(SourceTable* sources, uint32_t file, const TokenStream& stream);
+};
 
 struct ConfigParser {
     /**
-     * Parses the specified configuration file.
+     * The files loaded by this parser. Tokens refer to them by id.
+     */
+    SourceTable sources;
+    /**
+     * The parse cache, or nullptr to always tokenize.
+     */
+    ParseCache* cache = nullptr;
+    /**
+     * Runs blocks in function and control flow bodies on the bytecode VM instead of evaluating their nodes.
+     */
+    bool vm = false;
+    /**
+     * Counts calls that had side effects, such as impure native functions and set.
+     * The VM only falls back to the nodes in the middle of a block if this has not changed since the block started.
+     */
+    uint64_t effects = 0;
+    /**
+     * Counts the functions declared and the files loaded with use so far. Each of them keeps the compound stack it
+     * was declared or loaded on, so the scope of a call or a loop iteration is only freed if this has not changed while
+     * it was on the stack.
+     */
+    uint64_t captures = 0;
+    /**
+     * Reuses the results of calls of declared functions without side effects that had the same arguments.
+     */
+    bool memoize = true;
+    /**
+     * The number of calls of declared functions answered from earlier results.
+     */
+    uint64_t memoHits = 0;
+    /**
+     * The number of calls of declared functions without side effects that had to run the body.
+     */
+    uint64_t memoMisses = 0;
+    /**
+     * Folds calls of pure native functions on constants when expressions are compiled. Compiled blocks also keep
+     * the values of expressions that do not change within a loop, or that they compute more than once.
+     */
+    bool optimize = true;
+    /**
+     * Reports every change the optimizer makes on stderr.
+     */
+    bool explain = false;
+    /**
+     * The changes reported so far, so recompiling a block does not report them again.
+     */
+    std::unordered_set<std::string> explained;
+    /**
+     * Defers the values of compound members until they are first needed, if their end can be found without
+     * evaluating anything. Statements still run in order, after the values declared before them.
+     */
+    bool lazy = false;
+    /**
+     * The deferred values that may not have been evaluated yet, in the order they were declared.
+     */
+    std::vector<ThunkEntry*> pending;
+    /**
+     * The keys of the members whose values are being evaluated, from the outermost in. Values that mention one of
+     * them are not deferred, they would see the member itself instead of what the name meant before it.
+     */
+    std::vector<Symbol> declaring;
+    /**
+     * Set right before the value of a member is parsed if it is a compound, which is then kept by the member.
+     */
+    bool member = false;
+    /**
+     * Counts the deferred values that failed to evaluate. A parse during which one of them failed fails too.
+     */
+    uint64_t failures = 0;
+    /**
+     * Holds the entries and types created while parsing. They live as long as the parser.
+     */
+    Arena arena;
+
+    /**
+     * Parses the specified configuration file. The entries it returns live in the arena of this parser and function
+     * bodies refer to its files, so the parser must outlive every entry it returned. They are freed with the parser and
+     * must not be deleted once the parse has finished. Do not parse with a temporary, ConfigParser().parse(file) returns
+     * a root that is already freed.
      * @param configFile The path to the configuration file.
      * @return The root entry of the configuration file.
      */
     CompoundEntry* parse(const std::string& configFile);
     CompoundEntry* parse(const std::string& configFile, std::vector<CompoundEntry*>& compoundStack);
-    Type* parseType(std::vector<Token>& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
-    std::vector<Type::CompoundType>* parseCompoundTypes(std::vector<Token>& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
-    CompoundEntry* parseCompound(std::vector<Token>& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
-    ListEntry* parseList(std::vector<Token>& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
-    ConfigEntry* parseValue(std::vector<Token>& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
+    Type* parseType(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
+    std::vector<Type::CompoundType>* parseCompoundTypes(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
+    CompoundEntry* parseCompound(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
+    ListEntry* parseList(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
+    /**
+     * Parses the expression starting at the specified token.
+     * On a stored list the expression is compiled to a node the first time and the node is evaluated from then on.
+     * @param tokens The tokens.
+     * @param i The index of the first token, set to the index of the last token of the expression.
+     * @param compoundStack The compound stack.
+     * @return The value, or nullptr on error.
+     */
+    ConfigEntry* parseValue(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
+    /**
+     * Parses the expression starting at the specified token without compiling it.
+     */
+    ConfigEntry* parseToken(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
+    ConfigEntry* parseBlock(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
+    /**
+     * Looks up a path and calls it if it is a function.
+     * @param tokens The tokens.
+     * @param i The index of the last token of the path, set to the index of the last argument of a call.
+     * @param compoundStack The compound stack.
+     * @param path The path.
+     * @param native The native function named by the last part of the path, or nullptr.
+     * @return The value, or nullptr on error.
+     */
+    ConfigEntry* parsePath(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack, ScopePath& path, NativeFunctionEntry* native);
+    /**
+     * Looks up the dotted path starting at the specified token without calling it.
+     * On a stored list the lookup is cached in the node compiled from the path.
+     * @param tokens The tokens.
+     * @param i The index of the first token of the path, set to the index of its last token.
+     * @param compoundStack The compound stack.
+     * @return The entry, or nullptr if the path is invalid or not found.
+     */
+    ConfigEntry* findPath(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
+    /**
+     * Compiles the token at the specified index to a node.
+     * @param tokens The tokens.
+     * @param i The index of the token.
+     * @return The node.
+     */
+    Node* compile(TokenList& tokens, int i);
+    /**
+     * Creates a node that runs the block starting at the specified index on the bytecode VM.
+     * The block is compiled the first time it runs, when the functions it calls can be looked up.
+     * @param tokens The tokens.
+     * @param i The index of the block start.
+     * @return The node.
+     */
+    Node* compileBytecode(TokenList& tokens, int i);
+    /**
+     * Evaluates the expression starting at the specified token ahead of time if it is a call of a pure native
+     * function on constants: literals, true, false, blocks holding a single constant and other such calls. Calls that
+     * fail are not folded, they report their error when they run.
+     * @param tokens The tokens.
+     * @param i The index of the first token, set to the index of the last token of the expression if it was folded.
+     * @return The string or number it evaluates to, or nullptr if it is not folded.
+     */
+    ConfigEntry* fold(TokenList& tokens, int& i);
+    /**
+     * Reports a change the optimizer made to an expression if explain is set.
+     * @param tokens The tokens.
+     * @param from The index of the first token of the expression.
+     * @param to The index of the last token of the expression.
+     * @param change What was done to it.
+     * @param result What it became, or an empty string.
+     */
+    void optimized(TokenList& tokens, int from, int to, const std::string& change, const std::string& result = "");
+    /**
+     * Defers the value starting at the specified token if its end can be found without evaluating anything.
+     * @param tokens The tokens.
+     * @param i The index of the first token, set to the index of the last token of the value if it was deferred.
+     * @param compoundStack The compound stack.
+     * @return The deferred value, or nullptr to evaluate it now.
+     */
+    ThunkEntry* defer(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack);
+    /**
+     * Evaluates the pending values, and the values they declare while they are evaluated, in declaration order.
+     * @param scope Only evaluate the values that can see this compound, or nullptr for all of them.
+     * @return False if one of them failed.
+     */
+    bool forcePending(const CompoundEntry* scope = nullptr);
 };
 
 struct NativeFunctionEntry : public FunctionEntry {
-    std::function<ConfigEntry*(ConfigParser*, std::vector<CompoundEntry*>&, CompoundEntry* args)> func;
+    /**
+     * The implementation, which gets the arguments in the order they are declared in.
+     */
+    ConfigEntry* (*func)(ConfigParser*, std::vector<CompoundEntry*>&, ConfigEntry** args);
+    /**
+     * True if the function has no side effects and its result only depends on its arguments.
+     */
+    bool isPure;
+
+    NativeFunctionEntry(std::vector<Type::CompoundType> args, typeof(func) func, bool isPure = false);
+    ConfigEntry* invoke(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) override;
+};
+
+/**
+ * A compound member whose value is evaluated the first time it is needed. Like a function, it keeps the tokens of
+ * the value and the compound stack it was declared on, so it sees the same names it would have seen right away.
+ */
+struct ThunkEntry : public ConfigEntry {
+    ConfigParser* parser;
+    TokenList tokens;
+    std::vector<CompoundEntry*> compoundStack;
+    /**
+     * The type the member was declared with, or nullptr.
+     */
+    TypeEntry* type = nullptr;
+    /**
+     * The value once it has been evaluated.
+     */
+    ConfigEntry* value = nullptr;
+    bool evaluating = false;
+    bool failed = false;
 
-    NativeFunctionEntry(std::vector<Type::CompoundType> args, typeof(func) func);
-    virtual ConfigEntry* call(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, std::vector<Token>& tokens, int& i) override;
+    ThunkEntry(ConfigParser* parser, TokenList tokens, const std::vector<CompoundEntry*>& compoundStack);
+    /**
+     * Evaluates the value the first time it is called and returns the same value from then on.
+     * @return The value, or nullptr if it failed to evaluate.
+     */
+    ConfigEntry* force();
+    /**
+     * Checks if the value has been evaluated, or failed to.
+     */
+    bool isDone() const;
+    /**
+     * Checks if the value can see the names of the specified compound.
+     */
+    bool sees(const CompoundEntry* scope) const;
+    ConfigEntry* clone() override;
+    bool operator==(const ConfigEntry& other) override;
+    bool operator!=(const ConfigEntry& other) override;
+    void print(std::ostream& stream, int indent = 0) const override;
 };
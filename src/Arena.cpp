@@ -0,0 +1,64 @@
+#include <LynxConf.hpp>
+
+thread_local Arena* Arena::current = nullptr;
+
+// Sizes are rounded up to 16 bytes, each multiple of 16 up to classes * 16 has its own free list.
+static size_t roundUp(size_t size) {
+    return (size + 15) & ~(size_t) 15;
+}
+
+Arena::~Arena() {
+    for (char* chunk : this->chunks) {
+        ::operator delete(chunk);
+    }
+}
+
+void* Arena::allocate(size_t size) {
+    size = roundUp(size);
+    this->allocations++;
+    size_t index = size / 16 - 1;
+    if (index < classes && this->freeLists[index]) {
+        void* memory = this->freeLists[index];
+        this->freeLists[index] = *(void**) memory;
+        this->reused++;
+        return memory;
+    }
+    if (this->next + size > this->end) {
+        // the rest of the last chunk is dropped, entries are much smaller than a chunk
+        size_t length = size > chunkSize ? size : chunkSize;
+        char* chunk = (char*) ::operator new(length);
+        this->chunks.push_back(chunk);
+        this->reserved += length;
+        this->next = chunk;
+        this->end = chunk + length;
+    }
+    void* memory = this->next;
+    this->next += size;
+    return memory;
+}
+
+void Arena::release(void* memory, size_t size) {
+    size_t index = roundUp(size) / 16 - 1;
+    if (index >= classes) {
+        // large blocks stay where they are until the arena goes away
+        return;
+    }
+    *(void**) memory = this->freeLists[index];
+    this->freeLists[index] = memory;
+}
+
+void* ConfigEntry::operator new(size_t size) {
+    if (Arena::current) {
+        return Arena::current->allocate(size);
+    }
+    // rounded like the arena rounds it, so it can go on a free list if it is deleted during a parse
+    return ::operator new(roundUp(size));
+}
+
+void ConfigEntry::operator delete(void* memory, size_t size) {
+    if (Arena::current) {
+        Arena::current->release(memory, size);
+    } else {
+        ::operator delete(memory);
+    }
+}
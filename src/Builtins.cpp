@@ -1,23 +1,38 @@
 #include <LynxConf.hpp>
 
+#include <algorithm>
+
+// Captures the token at i, or the whole block if it starts one, and leaves i on its last token.
+// The start stays pinned while scanning so a streaming list keeps the captured tokens around.
+static TokenList captureBlock(TokenList& tokens, int& i) {
+    size_t start = i;
+    tokens.pin(start);
+    if (tokens.has(i) && tokens[i].type == Token::BlockStart) {
+        i = tokens.blockEnd(i);
+    }
+    TokenList block = tokens.slice(start, i + 1);
+    tokens.unpin();
+    return block;
+}
+
 std::unordered_map<std::string, BuiltinCommand> builtins {
-    std::pair("func", [](std::vector<Token> &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
+    std::pair("func", [](TokenList &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
         DeclaredFunctionEntry* entry = new DeclaredFunctionEntry();
         i++;
-        if (i >= tokens.size()) {
-            LYNX_ERR << "Expected block start but got " << tokens[i].value << std::endl;
+        if (!tokens.has(i)) {
+            LYNX_ERR << "Expected block start but got " << tokens.value(i) << std::endl;
             return nullptr;
         }
         i++;
-        while (i < tokens.size() && tokens[i].type != Token::BlockEnd) {
+        while (tokens.has(i) && tokens[i].type != Token::BlockEnd) {
             if (tokens[i].type != Token::Identifier) {
-                LYNX_ERR << "Expected Identifier but got " << tokens[i].value << std::endl;
+                LYNX_ERR << "Expected Identifier but got " << tokens.value(i) << std::endl;
                 return nullptr;
             }
-            std::string name = tokens[i].value;
+            Symbol name = tokens[i].symbol;
             i++;
-            if (i >= tokens.size() || tokens[i].type != Token::Is) {
-                LYNX_ERR << "Expected ':' but got " << tokens[i].value << std::endl;
+            if (!tokens.has(i) || tokens[i].type != Token::Is) {
+                LYNX_ERR << "Expected ':' but got " << tokens.value(i) << std::endl;
                 return nullptr;
             }
             i++;
@@ -30,52 +45,39 @@ std::unordered_map<std::string, BuiltinCommand> builtins {
             i++;
         }
         i++;
-        if (i >= tokens.size() || tokens[i].type != Token::BlockStart) {
-            LYNX_ERR << "Expected block start but got " << tokens[i].value << std::endl;
+        if (!tokens.has(i) || tokens[i].type != Token::BlockStart) {
+            LYNX_ERR << "Expected block start but got " << tokens.value(i) << std::endl;
             return nullptr;
         }
-        std::vector<Token> body;
-        body.push_back(tokens[i]);
-        i++;
-        int blockDepth = 1;
-        while (i < tokens.size() && blockDepth > 0) {
-            if (tokens[i].type == Token::BlockStart) {
-                blockDepth++;
-            } else if (tokens[i].type == Token::BlockEnd) {
-                blockDepth--;
-            }
-            body.push_back(tokens[i]);
-            i++;
-        }
-        i--;
-        entry->body = body;
+        entry->body = captureBlock(tokens, i);
         entry->compoundStack = compoundStack;
-        return entry->clone();
+        parser->captures++;
+        return entry;
     }),
-    std::pair("true", [](std::vector<Token> &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
+    std::pair("true", [](TokenList &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
         NumberEntry* entry = new NumberEntry();
         entry->setValue(1);
         return ((ConfigEntry*) entry);
     }),
-    std::pair("false", [](std::vector<Token> &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
+    std::pair("false", [](TokenList &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
         NumberEntry* entry = new NumberEntry();
         entry->setValue(0);
         return ((ConfigEntry*) entry);
     }),
-    std::pair("for", [](std::vector<Token> &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
+    std::pair("for", [](TokenList &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
         i++;
-        if (i >= tokens.size() || tokens[i].type != Token::Identifier) {
+        if (!tokens.has(i) || tokens[i].type != Token::Identifier) {
             LYNX_ERR << "Invalid for loop: Expected identifier" << std::endl;
             return nullptr;
         }
-        std::string iterVar = tokens[i].value;
+        Symbol iterVar = tokens[i].symbol;
         i++;
-        if (i >= tokens.size() || tokens[i].type != Token::Identifier) {
-            LYNX_ERR << "Invalid for loop: Expected 'in' but got " << tokens[i].value << std::endl;
+        if (!tokens.has(i) || tokens[i].type != Token::Identifier) {
+            LYNX_ERR << "Invalid for loop: Expected 'in' but got " << tokens.value(i) << std::endl;
             return nullptr;
         }
-        if (tokens[i].value != "in") {
-            LYNX_ERR << "Invalid for loop: Expected 'in' but got " << tokens[i].value << std::endl;
+        if (tokens.value(i) != "in") {
+            LYNX_ERR << "Invalid for loop: Expected 'in' but got " << tokens.value(i) << std::endl;
             return nullptr;
         }
         i++;
@@ -89,29 +91,14 @@ std::unordered_map<std::string, BuiltinCommand> builtins {
             return nullptr;
         }
         ListEntry* list = ((ListEntry*) entry);
-        if (i >= tokens.size() || tokens[i].type != Token::BlockStart) {
-            LYNX_ERR << "Invalid for loop: Expected block start but got " << tokens[i].value << std::endl;
+        if (!tokens.has(i) || tokens[i].type != Token::BlockStart) {
+            LYNX_ERR << "Invalid for loop: Expected block start but got " << tokens.value(i) << std::endl;
             return nullptr;
         }
         
-        std::vector<Token> forBody;
-        forBody.push_back(tokens[i]);
-        if (i < tokens.size() && tokens[i].type == Token::BlockStart) {
-            i++;
-            int blockDepth = 1;
-            while (i < tokens.size() && blockDepth > 0) {
-                if (tokens[i].type == Token::BlockStart) {
-                    blockDepth++;
-                } else if (tokens[i].type == Token::BlockEnd) {
-                    blockDepth--;
-                }
-                forBody.push_back(tokens[i]);
-                i++;
-            }
-            i--;
-        }
+        TokenList forBody = captureBlock(tokens, i);
         
-        if (i >= tokens.size()) {
+        if (!tokens.has(i)) {
             LYNX_ERR << "Unexpected end of file" << std::endl;
             return nullptr;
         }
@@ -119,41 +106,46 @@ std::unordered_map<std::string, BuiltinCommand> builtins {
         CompoundEntry* compound = nullptr;
         ConfigEntry* result = nullptr;
         for (size_t i = 0; i < list->size(); i++) {
-            auto value = list->get(i);
-            std::string oldKey = value->getKey();
+            // the values may be shared with other lists, so the loop variable is a copy
+            auto value = list->get(i)->clone();
             value->setKey(iterVar);
             compound = new CompoundEntry();
             compoundStack.push_back(compound);
             compound->add(value);
             int newI = 0;
+            uint64_t captures = parser->captures;
             ConfigEntry* next = parser->parseValue(forBody, newI, compoundStack);
             if (!next) {
                 LYNX_ERR << "Failed to parse for loop block" << std::endl;
-                value->setKey(oldKey);
                 return nullptr;
             }
             compoundStack.pop_back();
+            if (parser->captures == captures) {
+                delete compound;
+            }
             if (!result) {
                 result = next;
+                if (result->getType() == EntryType::List) {
+                    // the body usually yields as many values every time
+                    ((ListEntry*) result)->reserve(((ListEntry*) result)->size() * list->size());
+                }
             } else if (next->getType() != result->getType()) {
                 LYNX_ERR << "Invalid entry type in for loop block. Expected " << result->getType() << " but got " << next->getType() << std::endl;
-                value->setKey(oldKey);
                 return nullptr;
             } else {
                 bool sumEntries(ConfigEntry* finalEntry, ConfigEntry* entry);
                 if (!sumEntries(result, next)) {
-                    value->setKey(oldKey);
                     return nullptr;
                 }
+                delete next;
             }
-            value->setKey(oldKey);
         }
         if (!result) {
             return new StringEntry();
         }
         return result;
     }),
-    std::pair("if", [](std::vector<Token> &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
+    std::pair("if", [](TokenList &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
         i++;
         ConfigEntry* entry = parser->parseValue(tokens, i, compoundStack);
         i++;
@@ -167,53 +159,22 @@ std::unordered_map<std::string, BuiltinCommand> builtins {
             return nullptr;
         }
 
-        std::vector<Token> ifBlock;
-        ifBlock.push_back(tokens[i]);
-        if (i < tokens.size() && tokens[i].type == Token::BlockStart) {
-            i++;
-            int blockDepth = 1;
-            while (i < tokens.size() && blockDepth > 0) {
-                if (tokens[i].type == Token::BlockStart) {
-                    blockDepth++;
-                } else if (tokens[i].type == Token::BlockEnd) {
-                    blockDepth--;
-                }
-                ifBlock.push_back(tokens[i]);
-                i++;
-            }
-            i--;
-        }
+        bool condition = ((NumberEntry*) entry)->getValue() != 0;
+        delete entry;
 
-        std::vector<Token> elseBlock;
-        if (i + 1 < tokens.size() && tokens[i + 1].type == Token::Identifier && tokens[i + 1].value == "else") {
+        TokenList ifBlockToUse = captureBlock(tokens, i);
+        if (tokens.has(i + 1) && tokens[i + 1].type == Token::Identifier && tokens.value(i + 1) == "else") {
             i++;
             i++;
-            elseBlock.push_back(tokens[i]);
-            if (i < tokens.size() && tokens[i].type == Token::BlockStart) {
-                i++;
-                int blockDepth = 1;
-                while (i < tokens.size() && blockDepth > 0) {
-                    if (tokens[i].type == Token::BlockStart) {
-                        blockDepth++;
-                    } else if (tokens[i].type == Token::BlockEnd) {
-                        blockDepth--;
-                    }
-                    elseBlock.push_back(tokens[i]);
-                    i++;
-                }
-                i--;
+            TokenList elseBlock = captureBlock(tokens, i);
+            if (!condition) {
+                ifBlockToUse = elseBlock;
             }
-        } else {
-            Token t;
-            t.type = Token::String;
-            t.value = "";
-            elseBlock.push_back(t);
+        } else if (!condition) {
+            // a missing else block is an empty string
+            return new StringEntry();
         }
 
-        bool condition = ((NumberEntry*) entry)->getValue() != 0;
-
-        std::vector<Token>& ifBlockToUse = condition ? ifBlock : elseBlock;
-
         int newI = 0;
         ConfigEntry* result = parser->parseValue(ifBlockToUse, newI, compoundStack);
         if (!result) {
@@ -223,7 +184,7 @@ std::unordered_map<std::string, BuiltinCommand> builtins {
 
         return result;
     }),
-    std::pair("switch", [](std::vector<Token> &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
+    std::pair("switch", [](TokenList &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
         i++;
         ConfigEntry* entry = parser->parseValue(tokens, i, compoundStack);
         if (!entry) {
@@ -232,12 +193,12 @@ std::unordered_map<std::string, BuiltinCommand> builtins {
         }
         
         i++;
-        if (i >= tokens.size() || tokens[i].type != Token::BlockStart) {
+        if (!tokens.has(i) || tokens[i].type != Token::BlockStart) {
             LYNX_ERR << "Invalid switch block: Expected block start" << std::endl;
             return nullptr;
         }
         i++;
-        std::vector<std::pair<ConfigEntry*, std::vector<Token>>> cases;
+        std::vector<std::pair<ConfigEntry*, TokenList>> cases;
         // Parse cases
         /**
          * switch <expr> (
@@ -247,9 +208,9 @@ std::unordered_map<std::string, BuiltinCommand> builtins {
          * )
          */
         // <expr> can be a number, string, identifier, or block
-        while (i < tokens.size() && tokens[i].type != Token::BlockEnd) {
+        while (tokens.has(i) && tokens[i].type != Token::BlockEnd) {
             ConfigEntry* caseValue = nullptr;
-            if (tokens[i].type != Token::Identifier || tokens[i].value != "else") {
+            if (tokens[i].type != Token::Identifier || tokens.value(i) != "else") {
                 caseValue = parser->parseValue(tokens, i, compoundStack);
                 if (!caseValue) {
                     LYNX_ERR << "Failed to parse case value" << std::endl;
@@ -257,35 +218,20 @@ std::unordered_map<std::string, BuiltinCommand> builtins {
                 }
             }
             i++;
-            if (i >= tokens.size() || tokens[i].type != Token::Assign) {
-                LYNX_ERR << "Invalid switch block: Expected '=' but got " << tokens[i].value << std::endl;
+            if (!tokens.has(i) || tokens[i].type != Token::Assign) {
+                LYNX_ERR << "Invalid switch block: Expected '=' but got " << tokens.value(i) << std::endl;
                 return nullptr;
             }
             i++;
-            std::vector<Token> caseBlock;
-            caseBlock.push_back(tokens[i]);
-            if (i < tokens.size() && tokens[i].type == Token::BlockStart) {
-                i++;
-                int blockDepth = 1;
-                while (i < tokens.size() && blockDepth > 0) {
-                    if (tokens[i].type == Token::BlockStart) {
-                        blockDepth++;
-                    } else if (tokens[i].type == Token::BlockEnd) {
-                        blockDepth--;
-                    }
-                    caseBlock.push_back(tokens[i]);
-                    i++;
-                }
-                i--;
-            }
-            if (i >= tokens.size()) {
+            TokenList caseBlock = captureBlock(tokens, i);
+            if (!tokens.has(i)) {
                 LYNX_ERR << "Unexpected end of file" << std::endl;
                 return nullptr;
             }
             cases.push_back({caseValue, caseBlock});
             i++;
         }
-        if (i >= tokens.size() || tokens[i].type != Token::BlockEnd) {
+        if (!tokens.has(i) || tokens[i].type != Token::BlockEnd) {
             LYNX_ERR << "Invalid switch block: Expected block end" << std::endl;
             return nullptr;
         }
@@ -295,7 +241,7 @@ std::unordered_map<std::string, BuiltinCommand> builtins {
             ConfigEntry* caseValue = casePair.first;
             if (caseValue && caseValue->getType() == entry->getType() && caseValue->operator==(*entry)) {
                 int newI = 0;
-                std::vector<Token>& caseBlock = casePair.second;
+                TokenList& caseBlock = casePair.second;
                 result = parser->parseValue(caseBlock, newI, compoundStack);
                 if (!result) {
                     LYNX_ERR << "Failed to parse case block" << std::endl;
@@ -309,7 +255,7 @@ std::unordered_map<std::string, BuiltinCommand> builtins {
         for (auto& casePair : cases) {
             ConfigEntry* caseValue = casePair.first;
             if (caseValue == nullptr) {
-                std::vector<Token>& caseBlock = casePair.second;
+                TokenList& caseBlock = casePair.second;
                 int newI = 0;
                 result = parser->parseValue(caseBlock, newI, compoundStack);
                 if (!result) {
@@ -325,51 +271,22 @@ std::unordered_map<std::string, BuiltinCommand> builtins {
         }
         return result;
     }),
-    std::pair("exists", [](std::vector<Token> &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
-        auto byPath = [](std::string value, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
-            ConfigEntry* entry = nullptr;
-            for (size_t i = compoundStack.size(); i > 0 && !entry; i--) {
-                entry = compoundStack[i - 1]->getByPath(value);
-            }
-            if (!entry) {
-                return nullptr;
-            }
-            return entry->clone();
-        };
-
-        auto makePath = [](std::vector<Token>& tokens, int& i) -> std::string {
-            std::string path = tokens[i].value;
-            i++;
-            while (i < tokens.size() && tokens[i].type == Token::Dot) {
-                path += ".";
-                i++;
-                if (i >= tokens.size() || tokens[i].type != Token::Identifier) {
-                    LYNX_ERR << "Invalid path" << std::endl;
-                    return nullptr;
-                }
-                path += tokens[i].value;
-                i++;
-            }
-            i--;
-            return path;
-        };
-        
+    std::pair("exists", [](TokenList &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
         i++;
-        std::string path = makePath(tokens, i);
-        ConfigEntry* entry = byPath(path, compoundStack);
+        ConfigEntry* entry = parser->findPath(tokens, i, compoundStack);
         
         bool condition = entry != nullptr;
         NumberEntry* result = new NumberEntry();
         result->setValue(condition ? 1 : 0);
         return ((ConfigEntry*) result);
     }),
-    std::pair("set", [](std::vector<Token> &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
+    std::pair("set", [](TokenList &tokens, int &i, ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack) -> ConfigEntry* {
         i++;
-        if (i >= tokens.size() || tokens[i].type != Token::Identifier) {
+        if (!tokens.has(i) || tokens[i].type != Token::Identifier) {
             LYNX_ERR << "Invalid set block: Expected identifier" << std::endl;
             return nullptr;
         }
-        std::string key = tokens[i].value;
+        Symbol key = tokens[i].symbol;
         i++;
         ConfigEntry* entry = parser->parseValue(tokens, i, compoundStack);
         if (!entry) {
@@ -377,9 +294,45 @@ std::unordered_map<std::string, BuiltinCommand> builtins {
             return nullptr;
         }
         
-        entry = entry->clone();
-        entry->setKey(key);
-        compoundStack.back()->add(entry);
+        // the caller owns the result and may change it, the binding gets its own copy. Functions do not copy their
+        // key, so it is set on the copy
+        ConfigEntry* binding = entry->clone();
+        binding->setKey(key);
+        compoundStack.back()->add(binding);
+        parser->effects++;
         return ((ConfigEntry*) entry);
     }),
 };
+
+// The builtins by symbol id, less the id of the first one. The names are interned one after the other when the table
+// is built, before the first file is lexed, so their ids are close together and the table has few holes.
+struct BuiltinTable {
+    uint32_t first = 0;
+    std::vector<BuiltinCommand> commands;
+};
+
+static BuiltinTable buildBuiltinTable() {
+    BuiltinTable table;
+    std::vector<std::pair<Symbol, BuiltinCommand>> named;
+    for (auto& builtin : builtins) {
+        named.emplace_back(Symbol(builtin.first), builtin.second);
+    }
+    table.first = UINT32_MAX;
+    uint32_t last = 0;
+    for (auto& builtin : named) {
+        table.first = std::min(table.first, builtin.first.id);
+        last = std::max(last, builtin.first.id);
+    }
+    table.commands.resize(last - table.first + 1);
+    for (auto& builtin : named) {
+        table.commands[builtin.first.id - table.first] = builtin.second;
+    }
+    return table;
+}
+
+BuiltinCommand findBuiltin(Symbol name) {
+    static const BuiltinTable table = buildBuiltinTable();
+    // names before the first one wrap around to large indices
+    uint32_t index = name.id - table.first;
+    return index < table.commands.size() ? table.commands[index] : nullptr;
+}
@@ -1,15 +1,29 @@
 #include <LynxConf.hpp>
 
+static uint64_t versions = 0;
+static const EntryMap noEntries;
+
 CompoundEntry::CompoundEntry() {
     this->setType(EntryType::Compound);
-    this->entriesMap = {};
+    this->version = ++versions;
+}
+
+EntryMap& CompoundEntry::detach() {
+    if (!this->entriesMap) {
+        this->entriesMap = std::make_shared<EntryMap>();
+    } else if (this->entriesMap.use_count() > 1) {
+        this->entriesMap = std::make_shared<EntryMap>(*this->entriesMap);
+        ConfigEntry::copies++;
+    }
+    this->version = ++versions;
+    return *this->entriesMap;
 }
 
-bool CompoundEntry::hasMember(const std::string& key) const {
-    return this->entriesMap.find(key) != this->entriesMap.end();
+bool CompoundEntry::hasMember(Symbol key) const {
+    return this->entriesMap && this->entriesMap->find(key);
 }
 
-StringEntry* CompoundEntry::getString(const std::string& key) const {
+StringEntry* CompoundEntry::getString(Symbol key) const {
     auto x = get(key);
     if (x && x->getType() == EntryType::String) {
         return ((StringEntry*) x);
@@ -17,7 +31,7 @@ StringEntry* CompoundEntry::getString(const std::string& key) const {
     return nullptr;
 }
 
-StringEntry* CompoundEntry::getStringOrDefault(const std::string& key, const std::string& defaultValue) {
+StringEntry* CompoundEntry::getStringOrDefault(Symbol key, const std::string& defaultValue) {
     StringEntry* entry = getString(key);
     if (entry) {
         return ((StringEntry*) entry);
@@ -27,7 +41,7 @@ StringEntry* CompoundEntry::getStringOrDefault(const std::string& key, const std
     return entry;
 }
 
-NumberEntry* CompoundEntry::getNumber(const std::string& key) const {
+NumberEntry* CompoundEntry::getNumber(Symbol key) const {
     auto x = get(key);
     if (x && x->getType() == EntryType::Number) {
         return ((NumberEntry*) x);
@@ -35,7 +49,7 @@ NumberEntry* CompoundEntry::getNumber(const std::string& key) const {
     return nullptr;
 }
 
-ListEntry* CompoundEntry::getList(const std::string& key) const {
+ListEntry* CompoundEntry::getList(Symbol key) const {
     auto x = get(key);
     if (x && x->getType() == EntryType::List) {
         return ((ListEntry*) x);
@@ -43,7 +57,7 @@ ListEntry* CompoundEntry::getList(const std::string& key) const {
     return nullptr;
 }
 
-CompoundEntry* CompoundEntry::getCompound(const std::string& key) const {
+CompoundEntry* CompoundEntry::getCompound(Symbol key) const {
     auto x = get(key);
     if (x && x->getType() == EntryType::Compound) {
         return ((CompoundEntry*) x);
@@ -51,38 +65,55 @@ CompoundEntry* CompoundEntry::getCompound(const std::string& key) const {
     return nullptr;
 }
 
-ConfigEntry* CompoundEntry::get(const std::string& key) const {
-    auto it = this->entriesMap.find(key);
-    if (it != this->entriesMap.end()) {
-        return it->second;
+ConfigEntry* CompoundEntry::get(Symbol key) const {
+    if (!this->entriesMap) {
+        return ConfigEntry::Null;
+    }
+    ConfigEntry* entry = this->entriesMap->find(key);
+    if (!entry) {
+        return ConfigEntry::Null;
+    }
+    return entry->getType() == EntryType::Thunk ? this->evaluate(entry) : entry;
+}
+
+ConfigEntry* CompoundEntry::peek(Symbol key) const {
+    return this->entriesMap ? this->entriesMap->find(key) : nullptr;
+}
+
+ConfigEntry* CompoundEntry::evaluate(ConfigEntry* thunk) const {
+    ConfigEntry* value = ((ThunkEntry*) thunk)->force();
+    if (value) {
+        // the value is the same for every compound sharing the entries, so the version does not change
+        this->entriesMap->replace(thunk->getSymbol(), value);
     }
-    return ConfigEntry::Null;
+    return value;
 }
 
 ConfigEntry* CompoundEntry::getByPath(const std::string& path) const {
-    std::string key = "";
+    size_t dot = path.find('.');
+    if (dot == std::string::npos) {
+        return this->get(path);
+    }
+    std::string_view keys(path);
     const CompoundEntry* current = this;
-    for (char c : path) {
-        if (c == '.') {
-            if (key.size()) {
-                current = current->getCompound(key);
-                if (!current) {
-                    return nullptr;
-                }
-                key = "";
+    size_t start = 0;
+    for (; dot != std::string::npos; dot = path.find('.', start)) {
+        if (dot > start) {
+            current = current->getCompound(keys.substr(start, dot - start));
+            if (!current) {
+                return nullptr;
             }
-        } else {
-            key += c;
         }
+        start = dot + 1;
     }
-    return current->get(key);
+    return current->get(keys.substr(start));
 }
 
-ConfigEntry*& CompoundEntry::operator[](const std::string& key) {
-    return this->entriesMap[key];
+ConfigEntry*& CompoundEntry::operator[](Symbol key) {
+    return this->detach()[key];
 }
 
-void CompoundEntry::setString(const std::string& key, const std::string& value) {
+void CompoundEntry::setString(Symbol key, const std::string& value) {
     StringEntry* entry = getString(key);
     if (entry) {
         entry->setValue(value);
@@ -95,10 +126,10 @@ void CompoundEntry::setString(const std::string& key, const std::string& value)
 }
 
 void CompoundEntry::add(ConfigEntry* entry) {
-    this->entriesMap[entry->getKey()] = entry;
+    this->detach()[entry->getSymbol()] = entry;
 }
 
-void CompoundEntry::addString(const std::string& key, const std::string& value) {
+void CompoundEntry::addString(Symbol key, const std::string& value) {
     if (this->hasMember(key)) {
         std::cerr << "String with key '" << key << "' already exists" << std::endl;
         return;
@@ -109,7 +140,7 @@ void CompoundEntry::addString(const std::string& key, const std::string& value)
     add(((ConfigEntry*) newEntry));
 }
 
-void CompoundEntry::addList(const std::string& key, const std::vector<ConfigEntry*>& value) {
+void CompoundEntry::addList(Symbol key, const std::vector<ConfigEntry*>& value) {
     if (this->hasMember(key)) {
         std::cerr << "List with key '" << key << "' already exists!" << std::endl;
         return;
@@ -122,7 +153,7 @@ void CompoundEntry::addList(const std::string& key, const std::vector<ConfigEntr
     add(((ConfigEntry*) newEntry));
 }
 
-void CompoundEntry::addList(const std::string& key, ConfigEntry* value) {
+void CompoundEntry::addList(Symbol key, ConfigEntry* value) {
     if (this->hasMember(key)) {
         std::cerr << "List with key '" << key << "' already exists!" << std::endl;
         return;
@@ -134,7 +165,7 @@ void CompoundEntry::addList(const std::string& key, ConfigEntry* value) {
 }
 
 void CompoundEntry::addList(ListEntry* value) {
-    if (this->hasMember(value->getKey())) {
+    if (this->hasMember(value->getSymbol())) {
         std::cerr << "List with key '" << value->getKey() << "' already exists!" << std::endl;
         return;
     }
@@ -142,7 +173,7 @@ void CompoundEntry::addList(ListEntry* value) {
 }
 
 void CompoundEntry::addCompound(CompoundEntry* value) {
-    if (this->hasMember(value->getKey())) {
+    if (this->hasMember(value->getSymbol())) {
         std::cerr << "Compound with key '" << value->getKey() << "' already exists!" << std::endl;
         return;
     }
@@ -150,29 +181,76 @@ void CompoundEntry::addCompound(CompoundEntry* value) {
 }
 
 size_t CompoundEntry::merge(CompoundEntry* other) {
-    size_t count = 0;
-    for (auto& entry : other->entriesMap) {
-        this->add(entry.second);
-        count++;
+    if (!other->entriesMap) {
+        return 0;
+    }
+    if (other == this) {
+        return this->entriesMap->size();
     }
-    return count;
+    if (!this->entriesMap) {
+        this->entriesMap = other->entriesMap;
+        this->version = ++versions;
+        return this->entriesMap->size();
+    }
+    std::shared_ptr<EntryMap> from = other->entriesMap;
+    EntryMap& entries = this->detach();
+    entries.reserve(entries.size() + from->size());
+    for (auto& entry : *from) {
+        entries[entry.value->getSymbol()] = entry.value;
+    }
+    return from->size();
+}
+
+bool CompoundEntry::shares(const CompoundEntry* other) const {
+    return this->entriesMap && this->entriesMap == other->entriesMap;
 }
 
-void CompoundEntry::remove(const std::string& key) {
-    auto it = this->entriesMap.find(key);
-    if (it != this->entriesMap.end()) {
-        this->entriesMap.erase(it);
+bool CompoundEntry::isEvaluated() const {
+    if (this->entriesMap) {
+        for (auto& entry : *this->entriesMap) {
+            if (entry.value->getType() == EntryType::Thunk) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+const EntryMap& CompoundEntry::getEntries() const {
+    if (!this->entriesMap) {
+        return noEntries;
+    }
+    // evaluating a member may add members, so the position is looked up again every time
+    for (size_t n = 0; n < this->entriesMap->size(); n++) {
+        ConfigEntry* entry = (this->entriesMap->begin() + n)->value;
+        if (entry->getType() == EntryType::Thunk) {
+            this->evaluate(entry);
+        }
+    }
+    return *this->entriesMap;
+}
+
+void CompoundEntry::remove(Symbol key) {
+    if (this->hasMember(key)) {
+        this->detach().erase(key);
     } else {
         std::cerr << "Entry with key '" << key << "' not found!" << std::endl;
     }
 }
 
 void CompoundEntry::removeAll() {
-    this->entriesMap.clear();
+    this->entriesMap = nullptr;
+    this->version = ++versions;
+}
+
+void CompoundEntry::reserve(size_t size) {
+    if (size > 0) {
+        this->detach().reserve(size);
+    }
 }
 
 bool CompoundEntry::isEmpty() const {
-    return this->entriesMap.empty();
+    return !this->entriesMap || this->entriesMap->empty();
 }
 
 bool CompoundEntry::operator==(const ConfigEntry& other) {
@@ -180,24 +258,26 @@ bool CompoundEntry::operator==(const ConfigEntry& other) {
         return false;
     }
     const CompoundEntry& otherCompound = (const CompoundEntry&) other;
-    if (this->entriesMap.size() != otherCompound.entriesMap.size()) {
+    const auto& entries = this->getEntries();
+    const auto& otherEntries = otherCompound.getEntries();
+    if (entries.size() != otherEntries.size()) {
         return false;
     }
-    for (const auto& entry : this->entriesMap) {
-        auto it = otherCompound.entriesMap.find(entry.first);
-        if (it == otherCompound.entriesMap.end()) {
+    for (const auto& entry : entries) {
+        ConfigEntry* found = otherEntries.find(entry.key);
+        if (!found) {
             return false;
         }
-        if (!entry.second->operator==(*(it->second))) {
+        if (!entry.value->operator==(*found)) {
             return false;
         }
     }
-    for (const auto& entry : otherCompound.entriesMap) {
-        auto it = this->entriesMap.find(entry.first);
-        if (it == this->entriesMap.end()) {
+    for (const auto& entry : otherEntries) {
+        ConfigEntry* found = entries.find(entry.key);
+        if (!found) {
             return false;
         }
-        if (!entry.second->operator==(*(it->second))) {
+        if (!entry.value->operator==(*found)) {
             return false;
         }
     }
@@ -209,9 +289,10 @@ bool CompoundEntry::operator!=(const ConfigEntry& other) {
 }
 
 void CompoundEntry::print(std::ostream& stream, int indent) const {
+    const auto& entries = this->getEntries();
     if (this->getKey() == ".root") {
-        for (auto& entry : this->entriesMap) {
-            entry.second->print(stream, indent);
+        for (auto& entry : entries) {
+            entry.value->print(stream, indent);
         }
     } else {
         stream << std::string(indent, ' ');
@@ -220,8 +301,8 @@ void CompoundEntry::print(std::ostream& stream, int indent) const {
         } 
         stream << "{" << std::endl;
         indent += 2;
-        for (auto& entry : this->entriesMap) {
-            entry.second->print(stream, indent);
+        for (auto& entry : entries) {
+            entry.value->print(stream, indent);
         }
         indent -= 2;
         stream << std::string(indent, ' ') << "}" << std::endl;
@@ -230,7 +311,8 @@ void CompoundEntry::print(std::ostream& stream, int indent) const {
 
 ConfigEntry* CompoundEntry::clone() {
     CompoundEntry* entry = new CompoundEntry();
-    entry->setKey(this->getKey());
-    entry->merge(this);
+    entry->setKey(this->getSymbol());
+    entry->entriesMap = this->entriesMap;
+    ConfigEntry::clones++;
     return ((ConfigEntry*) entry);
 }
@@ -1,12 +1,15 @@
 #include <LynxConf.hpp>
 
-std::string ConfigEntry::getKey() const {
+const std::string& ConfigEntry::getKey() const {
+    return key.name();
+}
+Symbol ConfigEntry::getSymbol() const {
     return key;
 }
 EntryType ConfigEntry::getType() const {
     return type;
 }
-void ConfigEntry::setKey(const std::string& key) {
+void ConfigEntry::setKey(Symbol key) {
     this->key = key;
 }
 void ConfigEntry::setType(EntryType type) {
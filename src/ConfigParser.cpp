@@ -1,54 +1,66 @@
 #include <LynxConf.hpp>
 
-std::vector<Token> tokenize(std::string file, std::string& data, int& i);
+unsigned tokenizeThreads(size_t size);
+bool tokenize(SourceTable* sources, uint32_t file, TokenStream& stream);
 
 CompoundEntry* ConfigParser::parse(const std::string& configFile) {
     std::vector<CompoundEntry*> compoundStack;
     return this->parse(configFile, compoundStack);
 }
 
+static CompoundEntry* parseFile(ConfigParser* parser, const std::string& configFile, std::vector<CompoundEntry*>& compoundStack);
+
 CompoundEntry* ConfigParser::parse(const std::string& configFile, std::vector<CompoundEntry*>& compoundStack) {
-    FILE* fp = fopen(configFile.c_str(), "r");
-    if (!fp) {
+    // everything the parse creates comes from the arena of the parser, a file loaded with use shares it
+    Arena* previous = Arena::current;
+    Arena::current = &this->arena;
+    // the tables of builtins and native functions intern their names before the file does
+    findBuiltin(Symbol());
+    findNative(Symbol());
+    uint64_t failures = this->failures;
+    CompoundEntry* rootEntry = parseFile(this, configFile, compoundStack);
+    Arena::current = previous;
+    if (rootEntry && this->failures != failures) {
+        // a deferred value failed while the file was parsed, the parse would have failed on it without lazy
+        LYNX_RT_ERR << configFile << ": Failed to evaluate a value" << std::endl;
         return nullptr;
     }
-    fseek(fp, 0, SEEK_END);
-    size_t size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+    return rootEntry;
+}
 
-    char* buf = new char[size + 1];
-    fread(buf, 1, size, fp);
-    buf[size] = '\0';
-    fclose(fp);
-    std::string config = "{";
-    config.reserve(size + 3);
-    for (size_t i = 0; buf[i]; i++) {
-        if (buf[i] == '-' && buf[i + 1] == '-') {
-            while (buf[i] != '\n' && buf[i] != '\0') {
-                i++;
-            }
-        }
-        config += buf[i];
+static CompoundEntry* parseFile(ConfigParser* parser, const std::string& configFile, std::vector<CompoundEntry*>& compoundStack) {
+    int64_t file = parser->sources.load(configFile);
+    if (file < 0) {
+        return nullptr;
     }
-    delete[] buf;
-    config += "}";
 
-    int configSize = config.size();
-    bool inStr = false;
+    // tokens are lexed as the parser asks for them, wrapped in '{' and '}' like the body of the root compound
+    auto stream = std::make_shared<TokenStream>(&parser->sources, file);
+    bool cached = parser->cache && parser->cache->load(&parser->sources, file, *stream);
+    if (!cached && tokenizeThreads(parser->sources.files[file].data.size()) > 1) {
+        // large files are lexed up front on several threads and replayed from the packed form
+        if (!tokenize(&parser->sources, file, *stream)) {
+            LYNX_RT_ERR << configFile << ": Failed to tokenize" << std::endl;
+            return nullptr;
+        }
+    } else if (!cached && parser->cache) {
+        stream->recording = true;
+    }
+    TokenList tokens(stream);
 
-    std::string key = ".root";
     int i = 0;
-    auto tokens = tokenize(configFile, config, i);
-    if (tokens.empty() && configSize > 0) {
-        LYNX_ERR << "Failed to tokenize" << std::endl;
+    CompoundEntry* rootEntry = parser->parseCompound(tokens, i, compoundStack);
+    if (stream->failed) {
+        LYNX_RT_ERR << configFile << ": Failed to tokenize" << std::endl;
         return nullptr;
     }
-    i = 0;
-    CompoundEntry* rootEntry = parseCompound(tokens, i, compoundStack);
     if (!rootEntry) {
         LYNX_ERR << "Failed to parse compound" << std::endl;
         return nullptr;
     }
+    if (parser->cache && !cached && stream->done) {
+        parser->cache->store(&parser->sources, file, *stream);
+    }
     rootEntry->setKey(".root");
     return rootEntry;
 }
@@ -0,0 +1,87 @@
+#include <LynxConf.hpp>
+
+ConfigEntry*& EntryMap::operator[](Symbol key) {
+    size_t at = this->position(key);
+    if (at < this->members.size()) {
+        return this->members[at].value;
+    }
+    this->members.push_back({key, nullptr});
+    if (!this->index.empty() && this->members.size() * 2 <= this->index.size()) {
+        this->insert(at);
+    } else if (this->members.size() > linearLimit) {
+        this->rebuild(this->members.size());
+    }
+    return this->members[at].value;
+}
+
+void EntryMap::erase(Symbol key) {
+    size_t at = this->position(key);
+    if (at == this->members.size()) {
+        return;
+    }
+    this->members.erase(this->members.begin() + at);
+    // the positions after it moved, removing is rare enough to index them again
+    if (this->members.size() > linearLimit) {
+        this->rebuild(this->members.size());
+    } else {
+        this->index.clear();
+    }
+}
+
+void EntryMap::replace(Symbol key, ConfigEntry* value) {
+    size_t at = this->position(key);
+    if (at < this->members.size()) {
+        this->members[at].value = value;
+    }
+}
+
+void EntryMap::reserve(size_t size) {
+    this->members.reserve(size);
+    if (size > linearLimit && size * 2 > this->index.size()) {
+        this->rebuild(size);
+    }
+}
+
+size_t EntryMap::position(Symbol key) const {
+    if (this->index.empty()) {
+        for (size_t i = 0; i < this->members.size(); i++) {
+            if (this->members[i].key == key) {
+                return i;
+            }
+        }
+        return this->members.size();
+    }
+    size_t mask = this->index.size() - 1;
+    // symbol ids are handed out in order, the multiplication spreads them over the high bits
+    for (size_t slot = (uint32_t) (key.id * 2654435769u) >> this->shift;; slot = (slot + 1) & mask) {
+        uint32_t at = this->index[slot];
+        if (!at) {
+            return this->members.size();
+        }
+        if (this->members[at - 1].key == key) {
+            return at - 1;
+        }
+    }
+}
+
+void EntryMap::insert(size_t position) {
+    size_t mask = this->index.size() - 1;
+    size_t slot = (uint32_t) (this->members[position].key.id * 2654435769u) >> this->shift;
+    while (this->index[slot]) {
+        slot = (slot + 1) & mask;
+    }
+    this->index[slot] = position + 1;
+}
+
+void EntryMap::rebuild(size_t size) {
+    // at most half of the slots are used
+    uint32_t bits = 4;
+    while (((size_t) 1 << bits) < size * 2) {
+        bits++;
+    }
+    this->index.assign((size_t) 1 << bits, 0);
+    this->shift = 32 - bits;
+    for (size_t i = 0; i < this->members.size(); i++) {
+        this->insert(i);
+    }
+}
@@ -0,0 +1,506 @@
+#include <LynxConf.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Bump when the layout of an image changes.
+#define IMAGE_FORMAT 2
+// Images are written in host byte order, this reads differently on a host with the other one.
+#define IMAGE_BYTE_ORDER 0x01020304u
+
+// An image file is this header, the path of the file the image was written from and the image. The header is 32
+// bytes and the path is padded to 8, so the image stays aligned in a mapping.
+struct ImageHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t byteOrder;
+    uint64_t size;
+    uint64_t source;
+};
+
+static const char imageMagic[8] = {'L', 'Y', 'N', 'X', 'I', 'M', 'G', '\0'};
+
+// Longer source paths are taken as a sign of a damaged header.
+static const uint64_t maxSource = 4096;
+
+static uint64_t sourcePadded(uint64_t length) {
+    return (length + 7) & ~(uint64_t) 7;
+}
+
+#pragma region Freezer
+// Builds the sections of an image, then copies them into one block.
+struct Freezer {
+    std::vector<FrozenConfig::Node> nodes;
+    std::vector<uint32_t> tables;
+    std::vector<FrozenConfig::Slot> slots;
+    std::vector<FrozenConfig::String> strings;
+    std::string chars;
+    std::unordered_map<std::string, uint32_t> ids;
+
+    uint32_t intern(std::string_view value) {
+        auto found = this->ids.find(std::string(value));
+        if (found != this->ids.end()) {
+            return found->second;
+        }
+        uint32_t id = this->strings.size();
+        this->strings.push_back({FrozenConfig::hash(value), (uint32_t) this->chars.size(), (uint32_t) value.size()});
+        this->chars.append(value);
+        this->ids.emplace(value, id);
+        return id;
+    }
+
+    // Reserves the nodes of the members next to each other first, so they can be indexed by position.
+    uint32_t reserve(size_t count) {
+        uint32_t first = this->nodes.size();
+        this->nodes.resize(first + count);
+        this->tables.resize(first + count);
+        return first;
+    }
+
+    // Builds the hash table of a compound whose members are filled in, at most half of its slots are used.
+    void table(uint32_t at, const FrozenConfig::Node& node) {
+        uint32_t size = 16;
+        while (size < node.count * 2) {
+            size *= 2;
+        }
+        uint32_t start = this->slots.size();
+        this->slots.resize(start + size);
+        this->slots[start].node = size - 1;
+        FrozenConfig::Slot* table = this->slots.data() + start;
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            uint64_t hash = this->strings[this->nodes[i].key].hash;
+            uint32_t slot = hash & (size - 1);
+            // the first slot holds the mask
+            while (slot == 0 || table[slot].node) {
+                slot = (slot + 1) & (size - 1);
+            }
+            table[slot] = {i + 1, (uint32_t) (hash >> 32)};
+        }
+        this->tables[at] = start;
+    }
+
+    void fill(uint32_t at, ConfigEntry* entry) {
+        FrozenConfig::Node node = {};
+        node.type = entry->getType();
+        node.key = this->intern(entry->getKey());
+        switch (node.type) {
+            case EntryType::Number:
+                node.number = ((NumberEntry*) entry)->getValue();
+                break;
+            case EntryType::String:
+                node.first = this->intern(((StringEntry*) entry)->getValue());
+                break;
+            case EntryType::List: {
+                ListEntry* list = (ListEntry*) entry;
+                node.count = list->size();
+                node.first = this->reserve(node.count);
+                for (size_t i = 0; i < node.count; i++) {
+                    this->fill(node.first + i, list->get(i));
+                }
+                break;
+            }
+            case EntryType::Compound: {
+                const EntryMap& entries = ((CompoundEntry*) entry)->getEntries();
+                node.count = entries.size();
+                node.first = this->reserve(node.count);
+                uint32_t i = node.first;
+                for (auto& member : entries) {
+                    this->fill(i++, member.value);
+                }
+                if (node.count > FrozenConfig::linearLimit) {
+                    this->table(at, node);
+                }
+                break;
+            }
+            default: {
+                // functions and types can not be called or checked in an image, only their printed form is kept
+                std::ostringstream printed;
+                entry->print(printed);
+                std::string text = printed.str();
+                size_t start = entry->getKey().size() ? entry->getKey().size() + 2 : 0;
+                node.first = this->intern(std::string_view(text).substr(start, text.size() - start - 1));
+                break;
+            }
+        }
+        this->nodes[at] = node;
+    }
+};
+
+FrozenConfig* CompoundEntry::freeze() const {
+    Freezer freezer;
+    // the empty key of list values is string 0
+    freezer.intern("");
+    freezer.reserve(1);
+    freezer.fill(0, (ConfigEntry*) this);
+    // the tables are padded so the sections after them stay aligned
+    size_t tables = (freezer.tables.size() + 1) & ~(size_t) 1;
+    size_t size = sizeof(FrozenConfig::Header) + freezer.nodes.size() * sizeof(FrozenConfig::Node) + tables * sizeof(uint32_t)
+        + freezer.slots.size() * sizeof(FrozenConfig::Slot) + freezer.strings.size() * sizeof(FrozenConfig::String) + freezer.chars.size();
+    std::vector<char> image(size);
+    FrozenConfig::Header header = {(uint32_t) freezer.nodes.size(), (uint32_t) freezer.slots.size(), (uint32_t) freezer.strings.size(), (uint32_t) freezer.chars.size()};
+    char* at = image.data();
+    auto section = [&at](const void* data, size_t size, size_t padded) {
+        if (size) {
+            memcpy(at, data, size);
+        }
+        at += padded;
+    };
+    section(&header, sizeof(header), sizeof(header));
+    section(freezer.nodes.data(), freezer.nodes.size() * sizeof(FrozenConfig::Node), freezer.nodes.size() * sizeof(FrozenConfig::Node));
+    section(freezer.tables.data(), freezer.tables.size() * sizeof(uint32_t), tables * sizeof(uint32_t));
+    section(freezer.slots.data(), freezer.slots.size() * sizeof(FrozenConfig::Slot), freezer.slots.size() * sizeof(FrozenConfig::Slot));
+    section(freezer.strings.data(), freezer.strings.size() * sizeof(FrozenConfig::String), freezer.strings.size() * sizeof(FrozenConfig::String));
+    section(freezer.chars.data(), freezer.chars.size(), freezer.chars.size());
+    return new FrozenConfig(std::move(image));
+}
+#pragma endregion
+
+#pragma region FrozenConfig
+FrozenConfig::FrozenConfig(std::vector<char> image) : buffer(std::move(image)) {
+    this->attach(this->buffer.data(), this->buffer.size());
+}
+
+FrozenConfig::~FrozenConfig() {
+#ifndef _WIN32
+    if (this->mapping) {
+        munmap(this->mapping, this->mappingSize);
+    }
+#endif
+}
+
+bool FrozenConfig::attach(const char* bytes, size_t length) {
+    Header header;
+    if (length < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, bytes, sizeof(header));
+    size_t tables = ((size_t) header.nodes + 1) & ~(size_t) 1;
+    size_t expected = sizeof(header) + (size_t) header.nodes * sizeof(Node) + tables * sizeof(uint32_t) + (size_t) header.slots * sizeof(Slot)
+        + (size_t) header.strings * sizeof(String) + header.chars;
+    if (expected != length || header.nodes == 0 || header.strings == 0) {
+        return false;
+    }
+    this->bytes = bytes;
+    this->length = length;
+    const char* at = bytes + sizeof(header);
+    this->nodes = (const Node*) at;
+    at += header.nodes * sizeof(Node);
+    this->tables = (const uint32_t*) at;
+    at += tables * sizeof(uint32_t);
+    this->slots = (const Slot*) at;
+    at += header.slots * sizeof(Slot);
+    this->strings = (const String*) at;
+    at += header.strings * sizeof(String);
+    this->chars = at;
+    for (uint32_t id = 0; id < header.strings; id++) {
+        if ((uint64_t) this->strings[id].offset + this->strings[id].length > header.chars) {
+            return false;
+        }
+    }
+    if (this->nodes[0].type != EntryType::Compound) {
+        return false;
+    }
+    for (uint32_t n = 0; n < header.nodes; n++) {
+        const Node& node = this->nodes[n];
+        if (node.key >= header.strings) {
+            return false;
+        }
+        switch (node.type) {
+            case EntryType::Number:
+                break;
+            case EntryType::String:
+            case EntryType::Function:
+            case EntryType::Type:
+                if (node.first >= header.strings) {
+                    return false;
+                }
+                break;
+            case EntryType::List:
+            case EntryType::Compound:
+                // members always come after the node that holds them, so following them never loops
+                if (node.count && (node.first <= n || (uint64_t) node.first + node.count > header.nodes)) {
+                    return false;
+                }
+                if (node.type == EntryType::Compound && node.count > linearLimit && !this->checkTable(n, header.slots)) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+bool FrozenConfig::checkTable(uint32_t at, uint32_t slots) const {
+    const Node& node = this->nodes[at];
+    uint32_t start = this->tables[at];
+    if (start >= slots) {
+        return false;
+    }
+    uint64_t size = (uint64_t) this->slots[start].node + 1;
+    if ((size & (size - 1)) != 0 || size <= node.count || start + size > slots) {
+        return false;
+    }
+    // a lookup of a missing key only stops at a free slot
+    bool free = false;
+    for (uint64_t slot = 1; slot < size; slot++) {
+        uint32_t member = this->slots[start + slot].node;
+        if (!member) {
+            free = true;
+        } else if (member - 1 < node.first || member - 1 >= node.first + node.count) {
+            return false;
+        }
+    }
+    return free;
+}
+
+bool FrozenConfig::write(const std::string& path, const std::string& source) const {
+    ImageHeader header = {};
+    memcpy(header.magic, imageMagic, sizeof(imageMagic));
+    header.format = IMAGE_FORMAT;
+    header.byteOrder = IMAGE_BYTE_ORDER;
+    header.size = this->length;
+    header.source = source.size() <= maxSource ? source.size() : 0;
+    std::string padded = source.substr(0, header.source);
+    padded.resize(sourcePadded(header.source), '\0');
+    // write next to the file and rename it into place, readers never see a partial file
+    std::string temp = path + ".tmp." + std::to_string(getpid());
+    FILE* fp = fopen(temp.c_str(), "wb");
+    if (!fp) {
+        LYNX_RT_ERR << "Failed to write image " << temp << std::endl;
+        return false;
+    }
+    bool written = fwrite(&header, 1, sizeof(header), fp) == sizeof(header) && fwrite(padded.data(), 1, padded.size(), fp) == padded.size()
+        && fwrite(this->bytes, 1, this->length, fp) == this->length;
+    written = fclose(fp) == 0 && written;
+    std::error_code ec;
+    if (written) {
+        std::filesystem::rename(temp, path, ec);
+    }
+    if (!written || ec) {
+        LYNX_RT_ERR << "Failed to write image " << path << std::endl;
+        std::filesystem::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+// Checks the header of an image file, the error is reported if report is set.
+static bool checkHeader(const ImageHeader& header, const std::string& path, size_t size, bool report) {
+    const char* error = nullptr;
+    if (memcmp(header.magic, imageMagic, sizeof(imageMagic)) != 0) {
+        error = "Not an image";
+    } else if (header.format != IMAGE_FORMAT) {
+        error = "Unsupported image format version";
+    } else if (header.byteOrder != IMAGE_BYTE_ORDER) {
+        error = "Image was written with a different byte order";
+    } else if (header.source > maxSource || size - sizeof(header) < sourcePadded(header.source)
+        || header.size != size - sizeof(header) - sourcePadded(header.source)) {
+        error = "Truncated image";
+    }
+    if (error && report) {
+        LYNX_RT_ERR << error << ": " << path << std::endl;
+    }
+    return !error;
+}
+
+bool FrozenConfig::isImage(const std::string& path) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+    char magic[sizeof(imageMagic)];
+    bool image = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, imageMagic, sizeof(magic)) == 0;
+    fclose(fp);
+    return image;
+}
+
+FrozenConfig* FrozenConfig::load(const std::string& path) {
+    FrozenConfig* config = new FrozenConfig();
+    const char* data = nullptr;
+    size_t size = 0;
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (size_t) st.st_size >= sizeof(ImageHeader)) {
+            void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapping != MAP_FAILED) {
+                config->mapping = mapping;
+                config->mappingSize = st.st_size;
+                data = (const char*) mapping;
+                size = st.st_size;
+            }
+        }
+        close(fd);
+    }
+#endif
+    if (!data) {
+        FILE* fp = fopen(path.c_str(), "rb");
+        if (fp) {
+            char buf[65536];
+            size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+                config->buffer.insert(config->buffer.end(), buf, buf + n);
+            }
+            fclose(fp);
+            data = config->buffer.data();
+            size = config->buffer.size();
+        } else {
+            LYNX_RT_ERR << "Failed to open image " << path << std::endl;
+            delete config;
+            return nullptr;
+        }
+    }
+    ImageHeader header;
+    if (size < sizeof(header)) {
+        LYNX_RT_ERR << "Not an image: " << path << std::endl;
+        delete config;
+        return nullptr;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (!checkHeader(header, path, size, true)) {
+        delete config;
+        return nullptr;
+    }
+    size_t skip = sizeof(header) + sourcePadded(header.source);
+    if (!config->attach(data + skip, size - skip)) {
+        LYNX_RT_ERR << "Damaged image: " << path << std::endl;
+        delete config;
+        return nullptr;
+    }
+    return config;
+}
+
+std::string FrozenConfig::source(const std::string& path) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return "";
+    }
+    ImageHeader header;
+    std::string source;
+    if (fread(&header, 1, sizeof(header), fp) == sizeof(header) && memcmp(header.magic, imageMagic, sizeof(imageMagic)) == 0
+        && header.format == IMAGE_FORMAT && header.byteOrder == IMAGE_BYTE_ORDER && header.source <= maxSource) {
+        source.resize(header.source);
+        if (fread(source.data(), 1, source.size(), fp) != source.size()) {
+            source.clear();
+        }
+    }
+    fclose(fp);
+    return source;
+}
+
+uint64_t FrozenConfig::hash(std::string_view key) {
+    // FNV-1a, the same in every process, unlike symbol ids
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : key) {
+        hash ^= (unsigned char) c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+#pragma endregion
+
+#pragma region FrozenEntry
+FrozenEntry FrozenEntry::get(std::string_view key) const {
+    if (this->getType() != EntryType::Compound) {
+        return {};
+    }
+    const FrozenConfig* config = this->config;
+    const FrozenConfig::Node& node = config->nodes[this->node];
+    uint64_t hash = FrozenConfig::hash(key);
+    if (node.count <= FrozenConfig::linearLimit) {
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            uint32_t id = config->nodes[i].key;
+            if (config->strings[id].hash == hash && config->string(id) == key) {
+                return {config, i};
+            }
+        }
+        return {};
+    }
+    const FrozenConfig::Slot* table = config->slots + config->tables[this->node];
+    uint32_t mask = table[0].node;
+    for (uint32_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        if (slot == 0) {
+            continue;
+        }
+        if (!table[slot].node) {
+            return {};
+        }
+        uint32_t at = table[slot].node - 1;
+        if (table[slot].hash == (uint32_t) (hash >> 32) && config->string(config->nodes[at].key) == key) {
+            return {config, at};
+        }
+    }
+}
+
+FrozenEntry FrozenEntry::getByPath(std::string_view path) const {
+    FrozenEntry current = *this;
+    size_t start = 0;
+    // empty keys are skipped like CompoundEntry::getByPath does, except for the last one
+    for (size_t dot = path.find('.'); dot != std::string_view::npos; dot = path.find('.', start)) {
+        if (dot > start) {
+            current = current.get(path.substr(start, dot - start));
+            if (current.getType() != EntryType::Compound) {
+                return {};
+            }
+        }
+        start = dot + 1;
+    }
+    return current.get(path.substr(start));
+}
+
+void FrozenEntry::print(std::ostream& stream, int indent) const {
+    EntryType type = this->getType();
+    if (type == EntryType::Invalid) {
+        return;
+    }
+    std::string_view key = this->getKey();
+    bool root = type == EntryType::Compound && key == ".root";
+    if (!root) {
+        stream << std::string(indent, ' ');
+        if (key.size()) {
+            stream << key << ": ";
+        }
+    }
+    switch (type) {
+        case EntryType::Number:
+            stream << this->getNumber() << std::endl;
+            break;
+        case EntryType::String:
+            stream << "\"" << this->getString() << "\"" << std::endl;
+            break;
+        case EntryType::List:
+        case EntryType::Compound: {
+            if (!root) {
+                stream << (type == EntryType::List ? "[" : "{") << std::endl;
+                indent += 2;
+            }
+            for (size_t i = 0; i < this->size(); i++) {
+                (*this)[i].print(stream, indent);
+            }
+            if (!root) {
+                indent -= 2;
+                stream << std::string(indent, ' ') << (type == EntryType::List ? "]" : "}") << std::endl;
+            }
+            break;
+        }
+        default:
+            stream << this->config->string(this->config->nodes[this->node].first) << std::endl;
+    }
+}
+#pragma endregion
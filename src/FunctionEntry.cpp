@@ -1,9 +1,23 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <cstring>
+#include <algorithm>
 
 #include <LynxConf.hpp>
 
+#pragma region ArgFrame
+ArgFrame::ArgFrame(size_t arity) {
+    if (arity > inlineSize) {
+        this->spilled.resize(arity);
+        this->values = this->spilled.data();
+    } else {
+        std::fill(this->inlined, this->inlined + arity, nullptr);
+        this->values = this->inlined;
+    }
+}
+#pragma endregion
+
 #pragma region FunctionEntry
 FunctionEntry::FunctionEntry() {
     this->setType(EntryType::Function);
@@ -50,19 +64,19 @@ void FunctionEntry::print(std::ostream& stream, int indent) const {
 
 ConfigEntry* FunctionEntry::clone() {
     FunctionEntry* newFunc = new FunctionEntry();
+    ConfigEntry::clones++;
     newFunc->body = this->body;
     newFunc->args = this->args;
     newFunc->isDotCallable = this->isDotCallable;
     return newFunc;
 }
 
-ConfigEntry* FunctionEntry::call(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, std::vector<Token>& tokens, int& i) {
-    int tmp = 0;
-    CompoundEntry* args = this->parseArgs(parser, tokens, i, compoundStack);
-    compoundStack.push_back(args);
-    int x = 0;
-    ConfigEntry* result = parser->parseValue(this->body, x, compoundStack);
-    compoundStack.pop_back();
+ConfigEntry* FunctionEntry::call(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, TokenList& tokens, int& i) {
+    ArgFrame frame(this->args.size());
+    if (!this->parseArgs(parser, tokens, i, compoundStack, frame.values)) {
+        return nullptr;
+    }
+    ConfigEntry* result = this->invoke(parser, compoundStack, frame.values);
     if (!result) {
         LYNX_ERR << "Failed to run function" << std::endl;
         return nullptr;
@@ -70,53 +84,83 @@ ConfigEntry* FunctionEntry::call(ConfigParser* parser, std::vector<CompoundEntry
     return result;
 }
 
-CompoundEntry* FunctionEntry::parseArgs(ConfigParser* parser, std::vector<Token>& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
-    CompoundEntry* args = new CompoundEntry();
+ConfigEntry* FunctionEntry::invoke(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) {
+    compoundStack.push_back(this->makeScope(args));
+    int x = 0;
+    ConfigEntry* result = parser->parseValue(this->body, x, compoundStack);
+    compoundStack.pop_back();
+    return result;
+}
+
+bool FunctionEntry::parseArgs(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) {
     for (size_t n = 0; n < this->args.size(); n++) {
         i++;
-        std::string key = this->args[n].key;
-        Type* type = this->args[n].type;
+        size_t position = n;
         if (tokens[i].type == Token::Assign) {
             i++;
-            key = tokens[i].value;
-            bool found = false;
-            for (size_t j = 0; j < this->args.size(); j++) {
-                if (this->args[j].key == key) {
-                    type = this->args[j].type;
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
+            Symbol key = Symbol(tokens.value(i));
+            position = this->position(key);
+            if (position == this->args.size()) {
                 LYNX_ERR << "Invalid argument name '" << key << "'" << std::endl;
-                return nullptr;
+                return false;
             }
             i++;
         }
         ConfigEntry* arg = parser->parseValue(tokens, i, compoundStack);
         if (!arg) {
-            LYNX_ERR << "Failed to parse argument '" << key << "'" << std::endl;
-            return nullptr;
+            LYNX_ERR << "Failed to parse argument '" << this->args[position].key << "'" << std::endl;
+            return false;
+        }
+        if (!this->bindArg(tokens, i, position, arg, args)) {
+            return false;
         }
-        arg = arg->clone();
-        if (!type->validate(arg, {})) {
-            LYNX_ERR << "Invalid argument type" << std::endl;
-            return nullptr;
+    }
+    return true;
+}
+
+size_t FunctionEntry::position(Symbol name) const {
+    for (size_t n = 0; n < this->args.size(); n++) {
+        if (this->args[n].key == name) {
+            return n;
         }
-        arg->setKey(key);
-        args->add(arg);
     }
-    return args;
+    return this->args.size();
+}
+
+bool FunctionEntry::bindArg(TokenList& tokens, int i, size_t position, ConfigEntry* arg, ConfigEntry** args) {
+    const Type::CompoundType& declared = this->args[position];
+    if (!declared.type->validate(arg, {})) {
+        LYNX_ERR << "Invalid argument type" << std::endl;
+        return false;
+    }
+    if (args[position]) {
+        LYNX_ERR << "Argument '" << declared.key << "' is given more than once" << std::endl;
+        return false;
+    }
+    arg->setKey(declared.key);
+    args[position] = arg;
+    return true;
+}
+
+CompoundEntry* FunctionEntry::makeScope(ConfigEntry** args) const {
+    CompoundEntry* scope = new CompoundEntry();
+    scope->reserve(this->args.size());
+    for (size_t n = 0; n < this->args.size(); n++) {
+        scope->add(args[n]);
+    }
+    return scope;
 }
 #pragma endregion
 
 #pragma region DeclaredFunctionEntry
 ConfigEntry* DeclaredFunctionEntry::clone() {
     DeclaredFunctionEntry* newFunc = new DeclaredFunctionEntry();
+    ConfigEntry::clones++;
     newFunc->body = this->body;
     newFunc->args = this->args;
     newFunc->isDotCallable = this->isDotCallable;
     newFunc->compoundStack = this->compoundStack;
+    newFunc->memo = this->memo;
     return newFunc;
 }
 
@@ -125,38 +169,248 @@ DeclaredFunctionEntry::DeclaredFunctionEntry() {
     this->isDotCallable = false;
 }
 
-ConfigEntry* DeclaredFunctionEntry::call(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, std::vector<Token>& tokens, int& i) {
-    int tmp = 0;
-    CompoundEntry* args = this->parseArgs(parser, tokens, i, compoundStack);
-    this->compoundStack.push_back(args);
+// Adds a value to a hash.
+static void combine(uint64_t& hash, uint64_t value) {
+    hash ^= value + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+}
+
+// Hashes a value so that equal values hash the same. Returns false for values that cannot be compared, and for
+// compounds with deferred members, which are only evaluated when the body needs them.
+static bool hashEntry(const ConfigEntry* entry, uint64_t& hash) {
+    if (!entry) {
+        return false;
+    }
+    combine(hash, (uint64_t) entry->getType());
+    switch (entry->getType()) {
+        case EntryType::String:
+            combine(hash, std::hash<std::string>()(((StringEntry*) entry)->getValue()));
+            return true;
+        case EntryType::Number: {
+            // -0 equals 0
+            double value = ((NumberEntry*) entry)->getValue() + 0.0;
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            combine(hash, bits);
+            return true;
+        }
+        case EntryType::List: {
+            ListEntry* list = (ListEntry*) entry;
+            combine(hash, list->size());
+            for (size_t i = 0; i < list->size(); i++) {
+                if (!hashEntry(list->get(i), hash)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case EntryType::Compound: {
+            CompoundEntry* compound = (CompoundEntry*) entry;
+            if (!compound->isEvaluated()) {
+                return false;
+            }
+            // equal compounds may have their members in another order
+            uint64_t sum = 0;
+            for (auto& member : compound->getEntries()) {
+                uint64_t value = member.key.id;
+                if (!hashEntry(member.value, value)) {
+                    return false;
+                }
+                sum += value;
+            }
+            combine(hash, sum);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+FunctionMemo::FunctionMemo(const FunctionEntry& function) {
+    const TokenList& body = function.body;
+    for (size_t k = 0; body.has(k); k++) {
+        if (body[k].type != Token::Identifier || (k > 0 && body[k - 1].type == Token::Dot)) {
+            continue;
+        }
+        if (findBuiltin(body[k].symbol)) {
+            if (body[k].symbol == Symbol("set")) {
+                this->pure = false;
+            }
+            continue;
+        }
+        size_t head = k;
+        std::string path(body.value(k));
+        while (body.has(k + 2) && body[k + 1].type == Token::Dot && body[k + 2].type == Token::Identifier) {
+            k += 2;
+            path += ".";
+            path += body.value(k);
+        }
+        NativeFunctionEntry* native = findNative(body[k].symbol);
+        if (native) {
+            if (!native->isPure) {
+                this->pure = false;
+            }
+            continue;
+        }
+        bool argument = false;
+        for (const Type::CompoundType& arg : function.args) {
+            argument |= arg.key == body[head].symbol;
+        }
+        bool seen = false;
+        for (const ScopePath& known : this->paths) {
+            seen |= known.path == path;
+        }
+        if (!argument && !seen) {
+            this->paths.emplace_back(path);
+        }
+    }
+}
+
+// Records the versions of the compounds the paths in the body of a function are looked up in, and those of the paths
+// in the bodies of the declared functions they name. Versions are never reused and change with every member that is
+// added or removed, unlike addresses, which the arena hands to the next entry once one is freed. Returns false if one
+// of the functions has side effects, or if a path names a deferred value, which could be one.
+static bool collectNames(DeclaredFunctionEntry* function, std::vector<uint64_t>& names, std::vector<const DeclaredFunctionEntry*>& visited) {
+    if (!function->memo) {
+        function->memo = std::make_shared<FunctionMemo>(*function);
+    }
+    if (!function->memo->pure) {
+        return false;
+    }
+    const std::vector<CompoundEntry*>& stack = function->compoundStack;
+    for (const ScopePath& path : function->memo->paths) {
+        // members are only peeked at, looking them up would evaluate deferred ones the body may never need
+        ConfigEntry* entry = nullptr;
+        for (size_t s = stack.size(); s > 0 && !entry; s--) {
+            const CompoundEntry* current = stack[s - 1];
+            for (size_t k = 0; k < path.keys.size(); k++) {
+                ConfigEntry* member = current->peek(path.keys[k]);
+                names.push_back(current->version);
+                if (member && member->getType() == EntryType::Thunk) {
+                    return false;
+                }
+                if (k + 1 == path.keys.size()) {
+                    entry = member;
+                } else if (!member || member->getType() != EntryType::Compound) {
+                    break;
+                } else {
+                    current = (CompoundEntry*) member;
+                }
+            }
+        }
+        DeclaredFunctionEntry* callee = dynamic_cast<DeclaredFunctionEntry*>(entry);
+        if (callee && std::find(visited.begin(), visited.end(), callee) == visited.end()) {
+            visited.push_back(callee);
+            if (!collectNames(callee, names, visited)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+ConfigEntry* DeclaredFunctionEntry::invoke(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) {
+    uint64_t hash = 0;
+    std::vector<uint64_t> names;
+    bool memoized = false;
+    // a function whose calls rarely repeat costs more to memoize than to call
+    if (parser->memoize && (!this->memo || (this->memo->pure && (this->memo->misses < FunctionMemo::trial || this->memo->hits * 3 >= this->memo->misses)))) {
+        std::vector<const DeclaredFunctionEntry*> visited = {this};
+        memoized = collectNames(this, names, visited);
+        for (size_t n = 0; memoized && n < this->args.size(); n++) {
+            memoized = hashEntry(args[n], hash);
+        }
+    }
+    if (memoized) {
+        auto calls = this->memo->calls.equal_range(hash);
+        for (auto call = calls.first; call != calls.second; call++) {
+            if (call->second.names != names) {
+                continue;
+            }
+            bool same = true;
+            for (size_t n = 0; same && n < this->args.size(); n++) {
+                same = call->second.args[n]->operator==(*args[n]);
+            }
+            if (same) {
+                parser->memoHits++;
+                this->memo->hits++;
+                // the body never ran, nothing else holds the arguments
+                for (size_t n = 0; n < this->args.size(); n++) {
+                    delete args[n];
+                }
+                return call->second.result->clone();
+            }
+        }
+        parser->memoMisses++;
+        this->memo->misses++;
+    }
+    std::vector<ConfigEntry*> values;
+    if (memoized) {
+        // copied before the body runs, it may change them
+        for (size_t n = 0; n < this->args.size(); n++) {
+            values.push_back(args[n]->clone());
+        }
+    }
+
+    // functions are shared, not cloned, by the paths that call them, so each call gets its own stack
+    std::vector<CompoundEntry*> stack;
+    stack.reserve(this->compoundStack.size() + 1);
+    stack = this->compoundStack;
+    CompoundEntry* scope = this->makeScope(args);
+    stack.push_back(scope);
     int x = 0;
-    ConfigEntry* result = parser->parseValue(this->body, x, this->compoundStack);
-    this->compoundStack.pop_back();
-    if (!result) {
-        LYNX_ERR << "Failed to run function" << std::endl;
-        return nullptr;
+    uint64_t captures = parser->captures;
+    uint64_t effects = parser->effects;
+    ConfigEntry* result = parser->parseValue(this->body, x, stack);
+    if (parser->captures == captures) {
+        // nothing kept the stack, the values may still be shared with copies of the compound
+        delete scope;
+    }
+    if (memoized) {
+        // a result that kept the stack still refers to the arguments, and a call that had side effects after all,
+        // through a value that was evaluated when the body needed it, has to run again
+        if (result && parser->captures == captures && parser->effects == effects) {
+            if (this->memo->calls.size() >= FunctionMemo::limit) {
+                for (auto& call : this->memo->calls) {
+                    for (ConfigEntry* value : call.second.args) {
+                        delete value;
+                    }
+                    delete call.second.result;
+                }
+                this->memo->calls.clear();
+            }
+            this->memo->calls.insert({hash, {values, names, result->clone()}});
+        } else {
+            for (ConfigEntry* value : values) {
+                delete value;
+            }
+        }
     }
     return result;
 }
 #pragma endregion
 
 #pragma region NativeFunctionEntry
-ConfigEntry* NativeFunctionEntry::call(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, std::vector<Token>& tokens, int& i) {
-    int tmp = 0;
-    CompoundEntry* args = this->parseArgs(parser, tokens, i, compoundStack);
-    compoundStack.push_back(args);
+ConfigEntry* NativeFunctionEntry::invoke(ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) {
+    if (!this->isPure) {
+        parser->effects++;
+    }
     ConfigEntry* result = this->func(parser, compoundStack, args);
-    compoundStack.pop_back();
-    if (!result) {
-        LYNX_ERR << "Failed to run function" << std::endl;
-        return nullptr;
+    if (result && this->isPure) {
+        // a pure function keeps none of its arguments, only the one it returns is still used
+        for (size_t n = 0; n < this->args.size(); n++) {
+            ConfigEntry* value = args[n];
+            if (value && value != result && value->getType() != EntryType::Function) {
+                delete value;
+            }
+        }
     }
     return result;
 }
 
-NativeFunctionEntry::NativeFunctionEntry(std::vector<Type::CompoundType> args, typeof(NativeFunctionEntry::func) func) {
+NativeFunctionEntry::NativeFunctionEntry(std::vector<Type::CompoundType> args, typeof(NativeFunctionEntry::func) func, bool isPure) {
     this->setType(EntryType::Function);
     this->args = args;
     this->func = func;
+    this->isPure = isPure;
 }
 #pragma endregion
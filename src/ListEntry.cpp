@@ -2,7 +2,16 @@
 
 ListEntry::ListEntry() {
     this->setType(EntryType::List);
-    this->values = {};
+}
+
+std::vector<ConfigEntry*>& ListEntry::detach() {
+    if (!this->values) {
+        this->values = std::make_shared<std::vector<ConfigEntry*>>();
+    } else if (this->values.use_count() > 1) {
+        this->values = std::make_shared<std::vector<ConfigEntry*>>(*this->values);
+        ConfigEntry::copies++;
+    }
+    return *this->values;
 }
 
 ConfigEntry* ListEntry::get(unsigned long index) const {
@@ -10,11 +19,11 @@ ConfigEntry* ListEntry::get(unsigned long index) const {
         std::cerr << "Index out of bounds" << std::endl;
         return ConfigEntry::Null;
     }
-    return this->values.at(index);
+    return (*this->values)[index];
 }
 
 ConfigEntry*& ListEntry::operator[](unsigned long index) {
-    return this->values[index];
+    return this->detach()[index];
 }
 
 StringEntry* ListEntry::getString(unsigned long index) const {
@@ -22,7 +31,7 @@ StringEntry* ListEntry::getString(unsigned long index) const {
         std::cerr << "Index out of bounds" << std::endl;
         return nullptr;
     }
-    return (this->values[index]->getType() == EntryType::String ? ((StringEntry*) this->values[index]) : nullptr);
+    return ((*this->values)[index]->getType() == EntryType::String ? ((StringEntry*) (*this->values)[index]) : nullptr);
 }
 
 CompoundEntry* ListEntry::getCompound(unsigned long index) const {
@@ -30,7 +39,7 @@ CompoundEntry* ListEntry::getCompound(unsigned long index) const {
         std::cerr << "Index out of bounds" << std::endl;
         return nullptr;
     }
-    return (this->values[index]->getType() == EntryType::Compound ? ((CompoundEntry*) this->values[index]) : nullptr);
+    return ((*this->values)[index]->getType() == EntryType::Compound ? ((CompoundEntry*) (*this->values)[index]) : nullptr);
 }
 
 ListEntry* ListEntry::getList(unsigned long index) const {
@@ -38,11 +47,11 @@ ListEntry* ListEntry::getList(unsigned long index) const {
         std::cerr << "Index out of bounds" << std::endl;
         return nullptr;
     }
-    return (this->values[index]->getType() == EntryType::List ? ((ListEntry*) this->values[index]) : nullptr);
+    return ((*this->values)[index]->getType() == EntryType::List ? ((ListEntry*) (*this->values)[index]) : nullptr);
 }
 
 unsigned long ListEntry::size() const {
-    return this->values.size();
+    return this->values ? this->values->size() : 0;
 }
 
 void ListEntry::add(ConfigEntry* value) {
@@ -53,7 +62,13 @@ void ListEntry::add(ConfigEntry* value) {
     if (this->listType == EntryType::Invalid) {
         this->listType = value->getType();
     }
-    this->values.push_back(value);
+    this->detach().push_back(value);
+}
+
+void ListEntry::reserve(unsigned long size) {
+    if (size > this->size()) {
+        this->detach().reserve(size);
+    }
 }
 
 void ListEntry::remove(unsigned long index) {
@@ -61,8 +76,9 @@ void ListEntry::remove(unsigned long index) {
         std::cerr << "Index out of bounds" << std::endl;
         return;
     }
-    this->values.erase(this->values.begin() + index);
-    if (this->values.size() == 0) {
+    std::vector<ConfigEntry*>& values = this->detach();
+    values.erase(values.begin() + index);
+    if (values.size() == 0) {
         this->listType = EntryType::Invalid;
     }
 }
@@ -76,7 +92,7 @@ EntryType ListEntry::getListType() const {
 }
 
 void ListEntry::clear() {
-    this->values.clear();
+    this->values = nullptr;
     this->listType = EntryType::Invalid;
 }
 
@@ -92,9 +108,18 @@ void ListEntry::merge(ListEntry* other) {
     if (this->listType == EntryType::Invalid) {
         this->listType = other->getListType();
     }
-    for (unsigned long i = 0; i < other->size(); i++) {
-        this->add(other->get(i)->clone());
+    if (other->isEmpty()) {
+        return;
+    }
+    if (!this->values) {
+        this->values = other->values;
+        return;
     }
+    // the values themselves are never changed in place, so both lists can hold them
+    // holding on to the other values makes detach() copy them if this is the same list
+    std::shared_ptr<std::vector<ConfigEntry*>> from = other->values;
+    std::vector<ConfigEntry*>& values = this->detach();
+    values.insert(values.end(), from->begin(), from->end());
 }
 
 bool ListEntry::operator==(const ConfigEntry& other) {
@@ -109,7 +134,7 @@ bool ListEntry::operator==(const ConfigEntry& other) {
         return false;
     }
     for (unsigned long i = 0; i < this->size(); i++) {
-        if (this->values[i]->operator!=(*list.values[i])) {
+        if ((*this->values)[i]->operator!=(*(*list.values)[i])) {
             return false;
         }
     }
@@ -128,7 +153,7 @@ void ListEntry::print(std::ostream& stream, int indent) const {
     stream << "[" << std::endl;
     indent += 2;
     for (unsigned long i = 0; i < this->size(); i++) {
-        this->values[i]->print(stream, indent);
+        (*this->values)[i]->print(stream, indent);
     }
     indent -= 2;
     stream << std::string(indent, ' ') << "]" << std::endl;
@@ -136,8 +161,9 @@ void ListEntry::print(std::ostream& stream, int indent) const {
 
 ConfigEntry* ListEntry::clone() {
     ListEntry* entry = new ListEntry();
-    entry->setKey(this->getKey());
+    entry->setKey(this->getSymbol());
     entry->setListType(this->listType);
-    entry->merge(this);
+    entry->values = this->values;
+    ConfigEntry::clones++;
     return ((ConfigEntry*) entry);
 }
@@ -46,7 +46,7 @@ static ConfigEntry* typeToEntry(Type* type) {
 bool sumEntries(ConfigEntry* finalEntry, ConfigEntry* entry) {
     switch (entry->getType()) {
         case EntryType::String:
-            ((StringEntry*) finalEntry)->setValue(((StringEntry*) finalEntry)->getValue() + ((StringEntry*) entry)->getValue());
+            ((StringEntry*) finalEntry)->append(((StringEntry*) entry)->getValue());
             break;
         case EntryType::Number:
             ((NumberEntry*) finalEntry)->setValue(((NumberEntry*) finalEntry)->getValue() + ((NumberEntry*) entry)->getValue());
@@ -64,10 +64,10 @@ bool sumEntries(ConfigEntry* finalEntry, ConfigEntry* entry) {
     return true;
 }
 
-extern std::unordered_map<std::string, BuiltinCommand> builtins;
-extern std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions;
 
 ConfigEntry* ConfigEntry::Null = nullptr;
+uint64_t ConfigEntry::clones = 0;
+uint64_t ConfigEntry::copies = 0;
 
 std::ostream& operator<<(std::ostream& out, EntryType type) {
     switch (type) {
@@ -92,6 +92,9 @@ std::ostream& operator<<(std::ostream& out, EntryType type) {
         case EntryType::Any:
             out << "Any";
             break;
+        case EntryType::Thunk:
+            out << "Thunk";
+            break;
         case EntryType::Invalid:
             out << "Invalid";
             break;
@@ -99,14 +102,14 @@ std::ostream& operator<<(std::ostream& out, EntryType type) {
     return out;
 }
 
-ListEntry* ConfigParser::parseList(std::vector<Token>& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
+ListEntry* ConfigParser::parseList(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
     ListEntry* list = new ListEntry();
-    if (i >= tokens.size() || tokens[i].type != Token::ListStart) {
+    if (!tokens.has(i) || tokens[i].type != Token::ListStart) {
         LYNX_ERR << "Invalid list" << std::endl;
         return nullptr;
     }
     i++;
-    while (i < tokens.size() && tokens[i].type != Token::ListEnd) {
+    while (tokens.has(i) && tokens[i].type != Token::ListEnd) {
         ConfigEntry* entry = this->parseValue(tokens, i, compoundStack);
         if (!entry) {
             LYNX_ERR << "Failed to parse value" << std::endl;
@@ -125,42 +128,210 @@ ListEntry* ConfigParser::parseList(std::vector<Token>& tokens, int& i, std::vect
     return list;
 }
 
-ConfigEntry* ConfigParser::parseValue(std::vector<Token>& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
-    auto byPath = [&i, &compoundStack](std::string value, ConfigEntry** pParent) -> ConfigEntry* {
-        ConfigEntry* entry = nullptr;
-        ConfigEntry* parent = nullptr;
-        size_t x = value.find_last_of('.');
-        std::string parentPath = value.substr(0, x);
-        for (size_t i = compoundStack.size(); i > 0 && !entry; i--) {
-            if (x != std::string::npos) parent = compoundStack[i - 1]->getByPath(parentPath);
-            else parent = compoundStack[i - 1];
-            entry = compoundStack[i - 1]->getByPath(value);
-        }
-        if (pParent && parent) {
-            *pParent = parent->clone();
-        }
-        if (!entry) {
+static ConfigEntry* byPath(const std::string& value, std::vector<CompoundEntry*>& compoundStack) {
+    ConfigEntry* entry = nullptr;
+    for (size_t i = compoundStack.size(); i > 0 && !entry; i--) {
+        entry = compoundStack[i - 1]->getByPath(value);
+    }
+    return entry;
+}
+
+// Joins the identifiers of a dotted path and leaves i on its last token.
+static std::string makePath(TokenList& tokens, int& i) {
+    std::string path(tokens.value(i));
+    i++;
+    while (tokens.has(i) && tokens[i].type == Token::Dot) {
+        path += ".";
+        i++;
+        if (!tokens.has(i) || tokens[i].type != Token::Identifier) {
+            LYNX_ERR << "Invalid path" << std::endl;
             return nullptr;
         }
-        return entry->clone();
-    };
-    auto makePath = [](std::vector<Token>& tokens, int& i) -> std::string {
-        std::string path = tokens[i].value;
+        path += tokens.value(i);
         i++;
-        while (i < tokens.size() && tokens[i].type == Token::Dot) {
-            path += ".";
-            i++;
-            if (i >= tokens.size() || tokens[i].type != Token::Identifier) {
-                LYNX_ERR << "Invalid path" << std::endl;
-                return nullptr;
+    }
+    i--;
+    return path;
+}
+
+#pragma region Nodes
+// Falls back to parsing the tokens for expressions that are not worth compiling, and for errors.
+struct TokenNode : public Node {
+    ConfigEntry* eval(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) override {
+        return parser->parseToken(tokens, i, compoundStack);
+    }
+};
+
+struct StringNode : public Node {
+    std::string value;
+
+    ConfigEntry* eval(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) override {
+        StringEntry* entry = new StringEntry();
+        entry->setValue(this->value);
+        return entry;
+    }
+};
+
+struct NumberNode : public Node {
+    double value;
+
+    ConfigEntry* eval(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) override {
+        NumberEntry* entry = new NumberEntry();
+        entry->setValue(this->value);
+        return entry;
+    }
+};
+
+struct ListNode : public Node {
+    ConfigEntry* eval(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) override {
+        return parser->parseList(tokens, i, compoundStack);
+    }
+};
+
+struct CompoundNode : public Node {
+    ConfigEntry* eval(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) override {
+        return parser->parseCompound(tokens, i, compoundStack);
+    }
+};
+
+struct BlockNode : public Node {
+    ConfigEntry* eval(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) override {
+        return parser->parseBlock(tokens, i, compoundStack);
+    }
+};
+
+struct BuiltinNode : public Node {
+    BuiltinCommand command;
+
+    ConfigEntry* eval(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) override {
+        return this->command(tokens, i, parser, compoundStack);
+    }
+};
+
+struct PathNode : public Node {
+    ScopePath path;
+    // the offset of the last token of the path
+    int last;
+    NativeFunctionEntry* native;
+
+    // A slice that cuts the path short, or one that continues it, sees a different path.
+    bool fits(TokenList& tokens, int i) const {
+        return tokens.has(i + this->last) && !(tokens.has(i + this->last + 1) && tokens[i + this->last + 1].type == Token::Dot);
+    }
+
+    ConfigEntry* eval(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) override {
+        if (!this->fits(tokens, i)) {
+            return parser->parseToken(tokens, i, compoundStack);
+        }
+        i += this->last;
+        return parser->parsePath(tokens, i, compoundStack, this->path, this->native);
+    }
+};
+
+// A call of a pure native function on constants, evaluated when it was compiled.
+struct FoldNode : public Node {
+    bool isString;
+    std::string string;
+    double number;
+    // the offset of the last token of the call
+    int last;
+
+    ConfigEntry* eval(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) override {
+        if (!tokens.has(i + this->last)) {
+            // a slice that cuts the call short
+            return parser->parseToken(tokens, i, compoundStack);
+        }
+        i += this->last;
+        if (this->isString) {
+            StringEntry* entry = new StringEntry();
+            entry->setValue(this->string);
+            return entry;
+        }
+        NumberEntry* entry = new NumberEntry();
+        entry->setValue(this->number);
+        return entry;
+    }
+};
+#pragma endregion
+
+Node* ConfigParser::compile(TokenList& tokens, int i) {
+    switch (tokens[i].type) {
+        case Token::ListStart: return new ListNode();
+        case Token::CompoundStart: return new CompoundNode();
+        case Token::BlockStart: return new BlockNode();
+        case Token::String: {
+            StringNode* node = new StringNode();
+            node->value = tokens.value(i);
+            return node;
+        }
+        case Token::Number: {
+            NumberNode* node = new NumberNode();
+            try {
+                node->value = std::stod(std::string(tokens.value(i)));
+            } catch (const std::exception& e) {
+                // report the error each time the number is evaluated
+                delete node;
+                return new TokenNode();
             }
-            path += tokens[i].value;
-            i++;
+            return node;
+        }
+        case Token::Identifier: {
+            BuiltinCommand command = findBuiltin(tokens[i].symbol);
+            if (command) {
+                BuiltinNode* node = new BuiltinNode();
+                node->command = command;
+                return node;
+            }
+            int folded = i;
+            ConfigEntry* value = this->fold(tokens, folded);
+            if (value) {
+                FoldNode* node = new FoldNode();
+                node->isString = value->getType() == EntryType::String;
+                if (node->isString) {
+                    node->string = ((StringEntry*) value)->getValue();
+                } else {
+                    node->number = ((NumberEntry*) value)->getValue();
+                }
+                node->last = folded - i;
+                delete value;
+                return node;
+            }
+            int end = i + 1;
+            while (tokens.has(end + 1) && tokens[end].type == Token::Dot && tokens[end + 1].type == Token::Identifier) {
+                end += 2;
+            }
+            if (tokens.has(end) && tokens[end].type == Token::Dot) {
+                // an invalid path, the token parser reports it
+                return new TokenNode();
+            }
+            int last = i;
+            PathNode* node = new PathNode();
+            node->path = ScopePath(makePath(tokens, last));
+            node->last = last - i;
+            node->native = findNative(tokens[last].symbol);
+            return node;
         }
-        i--;
-        return path;
-    };
-    if (i >= tokens.size()) {
+        default:
+            return new TokenNode();
+    }
+}
+
+ConfigEntry* ConfigParser::parseValue(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
+    if (!tokens.has(i)) {
+        return nullptr;
+    }
+    std::unique_ptr<Node>* node = tokens.node(i);
+    if (!node) {
+        return this->parseToken(tokens, i, compoundStack);
+    }
+    if (!*node) {
+        node->reset(this->vm && tokens[i].type == Token::BlockStart ? this->compileBytecode(tokens, i) : this->compile(tokens, i));
+    }
+    return (*node)->eval(this, tokens, i, compoundStack);
+}
+
+ConfigEntry* ConfigParser::parseToken(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
+    if (!tokens.has(i)) {
         return nullptr;
     }
     switch (tokens[i].type) {
@@ -168,206 +339,212 @@ ConfigEntry* ConfigParser::parseValue(std::vector<Token>& tokens, int& i, std::v
         case Token::CompoundStart: return parseCompound(tokens, i, compoundStack);
         case Token::String: {
             StringEntry* entry = new StringEntry();
-            entry->setValue(tokens[i].value);
+            entry->setValue(std::string(tokens.value(i)));
             return ((ConfigEntry*) entry);
         }
         case Token::Number: {
             NumberEntry* entry = new NumberEntry();
             try {
-                entry->setValue(std::stod(tokens[i].value));
+                entry->setValue(std::stod(std::string(tokens.value(i))));
             } catch (const std::out_of_range& e) {
                 LYNX_ERR << "Failed to parse number: " << e.what() << std::endl;
                 return nullptr;
             } catch (const std::invalid_argument& e) {
-                LYNX_ERR << "Invalid argument to stod(): " << tokens[i].value << std::endl;
+                LYNX_ERR << "Invalid argument to stod(): " << tokens.value(i) << std::endl;
                 return nullptr;
             }
             return ((ConfigEntry*) entry);
         }
 
         case Token::Identifier: {
-            auto x = builtins.find(tokens[i].value);
-            if (x == builtins.end()) {
+            BuiltinCommand command = findBuiltin(tokens[i].symbol);
+            if (!command) {
                 std::string path = makePath(tokens, i);
                 if (path.empty()) {
                     return nullptr;
                 }
-                ConfigEntry* parent = nullptr;
-                ConfigEntry* entry;
-                auto nativeFunc = nativeFunctions.find(tokens[i].value);
-                if (nativeFunc != nativeFunctions.end()) {
-                    entry = nativeFunc->second;
-                } else {
-                    entry = byPath(path, &parent);
-                }
-                if (!entry) {
-                    LYNX_ERR << "Failed to find entry by path '" << path << "'" << std::endl;
-                    return nullptr;
-                }
-                if (entry->getType() == EntryType::Function) {
-                    return ((FunctionEntry*) entry)->call(this, compoundStack, tokens, i);
-                } else {
-                    return ((ConfigEntry*) entry);
-                }
+                ScopePath scope(path);
+                return this->parsePath(tokens, i, compoundStack, scope, findNative(tokens[i].symbol));
             }
-            ConfigEntry* entry = x->second(tokens, i, this, compoundStack);
+            ConfigEntry* entry = command(tokens, i, this, compoundStack);
             return ((ConfigEntry*) entry);
         }
-        case Token::BlockStart: {
-            i++;
-            ConfigEntry* finalEntry = parseValue(tokens, i, compoundStack);
-            if (!finalEntry) {
-                LYNX_ERR << "Failed to parse value" << std::endl;
-                return nullptr;
-            }
-            i++;
-
-            while (i < tokens.size() && tokens[i].type != Token::BlockEnd) {
-                ConfigEntry* entry = parseValue(tokens, i, compoundStack);
-                i++;
-                if (!entry) {
-                    LYNX_ERR << "Failed to parse value" << std::endl;
-                    return nullptr;
-                }
-                if (entry->getType() != finalEntry->getType()) {
-                    if (entry->getType() == EntryType::List) {
-                        if (((ListEntry*) entry)->getListType() != finalEntry->getType()) {
-                            LYNX_ERR << "Invalid entry type in list. Expected " << finalEntry->getType() << " but got " << entry->getType() << std::endl;
-                            return nullptr;
-                        }
-                        ListEntry* list = (ListEntry*) entry;
-                        for (size_t i = 0; i < list->size(); i++) {
-                            if (!sumEntries(finalEntry, list->get(i))) {
-                                return nullptr;
-                            }
-                        }
-                    } else if (entry->getType() == EntryType::Number && finalEntry->getType() == EntryType::String) {
-                        double value = (((NumberEntry*) entry))->getValue();
-                        ((StringEntry*) finalEntry)->setValue(((StringEntry*) finalEntry)->getValue() + std::to_string(value));
-                    } else if (finalEntry->getType() == EntryType::Number && entry->getType() == EntryType::String) {
-                        std::string value = std::to_string(((NumberEntry*) finalEntry)->getValue());
-                        finalEntry = new StringEntry();
-                        ((StringEntry*) finalEntry)->setValue(value + ((StringEntry*) entry)->getValue());
-                    } else {
-                        LYNX_ERR << "Invalid entry type. Expected " << finalEntry->getType() << " but got " << entry->getType() << std::endl;
-                        return nullptr;
-                    }
-                } else if (!sumEntries(finalEntry, entry)) {
-                    return nullptr;
-                }
-            }
-            return finalEntry;
-        }
+        case Token::BlockStart: return parseBlock(tokens, i, compoundStack);
         case Token::Dot: {
             return compoundStack.back()->clone();
         }
         default:
-            LYNX_ERR << "Invalid token: " << tokens[i].value << std::endl;
+            LYNX_ERR << "Invalid token: " << tokens.value(i) << std::endl;
             return nullptr;
     }
 }
 
-Type* ConfigParser::parseType(std::vector<Token>& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
-    auto byPath = [&i, &compoundStack](std::string value) -> ConfigEntry* {
-        ConfigEntry* entry = nullptr;
-        for (size_t i = compoundStack.size(); i > 0 && !entry; i--) {
-            entry = compoundStack[i - 1]->getByPath(value);
+ConfigEntry* ConfigParser::parsePath(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack, ScopePath& path, NativeFunctionEntry* native) {
+    ConfigEntry* entry = native ? native : path.find(compoundStack);
+    if (!entry) {
+        LYNX_ERR << "Failed to find entry by path '" << path.path << "'" << std::endl;
+        return nullptr;
+    }
+    if (entry->getType() == EntryType::Function) {
+        return ((FunctionEntry*) entry)->call(this, compoundStack, tokens, i);
+    } else {
+        return entry->clone();
+    }
+}
+
+ConfigEntry* ConfigParser::findPath(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
+    std::unique_ptr<Node>* node = tokens.has(i) && tokens[i].type == Token::Identifier ? tokens.node(i) : nullptr;
+    if (node && !*node) {
+        node->reset(this->compile(tokens, i));
+    }
+    PathNode* pathNode = node ? dynamic_cast<PathNode*>(node->get()) : nullptr;
+    if (pathNode && pathNode->fits(tokens, i)) {
+        i += pathNode->last;
+        return pathNode->path.find(compoundStack);
+    }
+    std::string path = makePath(tokens, i);
+    return byPath(path, compoundStack);
+}
+
+// Adds the value of an expression in a block to the value of the block, converting numbers to strings if needed.
+// The value is freed once it has been added.
+bool addBlockEntry(ConfigEntry*& finalEntry, ConfigEntry* entry, TokenList& tokens, int i) {
+    if (entry->getType() != finalEntry->getType()) {
+        if (entry->getType() == EntryType::List) {
+            if (((ListEntry*) entry)->getListType() != finalEntry->getType()) {
+                LYNX_ERR << "Invalid entry type in list. Expected " << finalEntry->getType() << " but got " << entry->getType() << std::endl;
+                return false;
+            }
+            ListEntry* list = (ListEntry*) entry;
+            for (size_t i = 0; i < list->size(); i++) {
+                if (!sumEntries(finalEntry, list->get(i))) {
+                    return false;
+                }
+            }
+        } else if (entry->getType() == EntryType::Number && finalEntry->getType() == EntryType::String) {
+            double value = (((NumberEntry*) entry))->getValue();
+            ((StringEntry*) finalEntry)->append(std::to_string(value));
+        } else if (finalEntry->getType() == EntryType::Number && entry->getType() == EntryType::String) {
+            std::string value = std::to_string(((NumberEntry*) finalEntry)->getValue());
+            delete finalEntry;
+            finalEntry = new StringEntry();
+            ((StringEntry*) finalEntry)->setValue(value);
+            ((StringEntry*) finalEntry)->append(((StringEntry*) entry)->getValue());
+        } else {
+            LYNX_ERR << "Invalid entry type. Expected " << finalEntry->getType() << " but got " << entry->getType() << std::endl;
+            return false;
         }
+    } else if (!sumEntries(finalEntry, entry)) {
+        return false;
+    }
+    // the value is part of the block now, lists and compounds only handed on the values they hold
+    delete entry;
+    return true;
+}
+
+ConfigEntry* ConfigParser::parseBlock(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
+    i++;
+    ConfigEntry* finalEntry = parseValue(tokens, i, compoundStack);
+    if (!finalEntry) {
+        LYNX_ERR << "Failed to parse value" << std::endl;
+        return nullptr;
+    }
+    i++;
+
+    while (tokens.has(i) && tokens[i].type != Token::BlockEnd) {
+        ConfigEntry* entry = parseValue(tokens, i, compoundStack);
+        i++;
         if (!entry) {
+            LYNX_ERR << "Failed to parse value" << std::endl;
             return nullptr;
         }
-        return entry->clone();
-    };
-    auto makePath = [](std::vector<Token>& tokens, int& i) -> std::string {
-        std::string path = tokens[i].value;
-        i++;
-        while (i < tokens.size() && tokens[i].type == Token::Dot) {
-            path += ".";
-            i++;
-            if (i >= tokens.size() || tokens[i].type != Token::Identifier) {
-                LYNX_ERR << "Invalid path" << std::endl;
-                return nullptr;
-            }
-            path += tokens[i].value;
-            i++;
+        if (!addBlockEntry(finalEntry, entry, tokens, i)) {
+            return nullptr;
         }
-        i--;
-        return path;
-    };
-    Type* t = new Type();
-    if (i >= tokens.size() || tokens[i].type != Token::Identifier) {
-        LYNX_ERR << "Invalid type: " << tokens[i].value << std::endl;
+    }
+    return finalEntry;
+}
+
+Type* ConfigParser::parseType(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
+    Type* t = nullptr;
+    if (!tokens.has(i) || tokens[i].type != Token::Identifier) {
+        LYNX_ERR << "Invalid type: " << tokens.value(i) << std::endl;
         return nullptr;
     }
 
-    if (tokens[i].value == "optional") {
-        t->isOptional = true;
+    bool isOptional = false;
+    if (tokens.value(i) == "optional") {
+        isOptional = true;
         i++;
     }
 
-    if (tokens[i].value == "string") {
-        t->type = EntryType::String;
-    } else if (tokens[i].value == "number") {
-        t->type = EntryType::Number;
-    } else if (tokens[i].value == "any") {
-        t->type = EntryType::Any;
-    } else if (tokens[i].value == "list") {
+    if (tokens.value(i) == "string") {
+        t = Type::String();
+    } else if (tokens.value(i) == "number") {
+        t = Type::Number();
+    } else if (tokens.value(i) == "any") {
+        t = Type::Any();
+    } else if (tokens.value(i) == "list") {
         i++;
-        if (i >= tokens.size() || tokens[i].type != Token::ListStart) {
-            LYNX_ERR << "Expected list start but got " << tokens[i].value << std::endl;
+        if (!tokens.has(i) || tokens[i].type != Token::ListStart) {
+            LYNX_ERR << "Expected list start but got " << tokens.value(i) << std::endl;
             return nullptr;
         }
         i++;
-        t->type = EntryType::List;
-        t->listType = parseType(tokens, i, compoundStack);
-        if (!t->listType) {
+        Type* listType = parseType(tokens, i, compoundStack);
+        if (!listType) {
             LYNX_ERR << "Failed to parse list type" << std::endl;
             return nullptr;
         }
+        t = Type::List(listType);
         i++;
-    } else if (tokens[i].value == "compound") {
+    } else if (tokens.value(i) == "compound") {
         i++;
-        if (i >= tokens.size() || tokens[i].type != Token::CompoundStart) {
-            LYNX_ERR << "Expected compound start but got " << tokens[i].value << std::endl;
+        if (!tokens.has(i) || tokens[i].type != Token::CompoundStart) {
+            LYNX_ERR << "Expected compound start but got " << tokens.value(i) << std::endl;
+            return nullptr;
+        }
+        std::vector<Type::CompoundType>* compoundTypes = parseCompoundTypes(tokens, i, compoundStack);
+        if (!compoundTypes) {
             return nullptr;
         }
-        t->type = EntryType::Compound;
-        t->compoundTypes = parseCompoundTypes(tokens, i, compoundStack);
+        t = Type::Compound(*compoundTypes);
+        delete compoundTypes;
     } else {
-        std::string path = makePath(tokens, i);
-        ConfigEntry* typeEntry = byPath(path);
+        int start = i;
+        ConfigEntry* typeEntry = this->findPath(tokens, i, compoundStack);
         if (!typeEntry) {
-            LYNX_ERR << "Failed to find entry by path '" << path << "'" << std::endl;
+            LYNX_ERR << "Failed to find entry by path '" << makePath(tokens, start) << "'" << std::endl;
             return nullptr;
         }
         if (typeEntry->getType() != EntryType::Type) {
             LYNX_ERR << "Invalid entry type. Expected Type but got " << typeEntry->getType() << std::endl;
             return nullptr;
         }
-        TypeEntry* entry = ((TypeEntry*) typeEntry);
-        t = entry->type;
+        // types are interned, every reference to a named type shares it
+        t = ((TypeEntry*) typeEntry)->type;
     }
-    return t;
+    return isOptional ? Type::Optional(t) : t;
 }
 
-std::vector<Type::CompoundType>* ConfigParser::parseCompoundTypes(std::vector<Token>& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
+std::vector<Type::CompoundType>* ConfigParser::parseCompoundTypes(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
     std::vector<Type::CompoundType>* compound = new std::vector<Type::CompoundType>();
-    if (i >= tokens.size() || tokens[i].type != Token::CompoundStart) {
+    if (!tokens.has(i) || tokens[i].type != Token::CompoundStart) {
         LYNX_ERR << "Invalid compound" << std::endl;
         compoundStack.pop_back();
         return nullptr;
     }
     i++;
-    while (tokens.size() > 0 && tokens[i].type != Token::CompoundEnd) {
+    while (tokens.has(i) && tokens[i].type != Token::CompoundEnd) {
         if (tokens[i].type != Token::Identifier) {
-            LYNX_ERR << "Invalid type specification: " << tokens[i].value << std::endl;
+            LYNX_ERR << "Invalid type specification: " << tokens.value(i) << std::endl;
             compoundStack.pop_back();
             return nullptr;
         }
-        std::string key = tokens[i].value;
+        Symbol key = tokens[i].symbol;
         i++;
-        if (i >= tokens.size() || tokens[i].type != Token::Is) {
-            LYNX_ERR << "Invalid type assignment: " << tokens[i].value << std::endl;
+        if (!tokens.has(i) || tokens[i].type != Token::Is) {
+            LYNX_ERR << "Invalid type assignment: " << tokens.value(i) << std::endl;
             compoundStack.pop_back();
             return nullptr;
         }
@@ -390,26 +567,49 @@ std::vector<Type::CompoundType>* ConfigParser::parseCompoundTypes(std::vector<To
     return compound;
 }
 
-CompoundEntry* ConfigParser::parseCompound(std::vector<Token>& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
+// Checks if a name is visible from the top of the stack.
+static bool declared(const std::vector<CompoundEntry*>& compoundStack, Symbol key) {
+    for (const CompoundEntry* scope : compoundStack) {
+        if (scope->hasMember(key)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+CompoundEntry* ConfigParser::parseCompound(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
     CompoundEntry* compound = new CompoundEntry();
+    compound->lasting = this->lazy && (compoundStack.empty() || (this->member && compoundStack.back()->lasting));
+    this->member = false;
     compoundStack.push_back(compound);
-    if (i >= tokens.size() || tokens[i].type != Token::CompoundStart) {
+    if (!tokens.has(i) || tokens[i].type != Token::CompoundStart) {
         LYNX_ERR << "Invalid compound" << std::endl;
         compoundStack.pop_back();
         return nullptr;
     }
     i++;
-    while (i < tokens.size() && tokens[i].type != Token::CompoundEnd) {
+    while (tokens.has(i) && tokens[i].type != Token::CompoundEnd) {
         if (tokens[i].type == Token::BlockStart) {
+            // statements run after the values declared before them, like they would have without lazy
+            if (this->lazy && !this->forcePending()) {
+                LYNX_ERR << "Failed to evaluate the values before a statement" << std::endl;
+                compoundStack.pop_back();
+                return nullptr;
+            }
             i++;
+            uint64_t captures = this->captures;
             ConfigEntry* entry = parseValue(tokens, i, compoundStack);
             if (!entry) {
                 LYNX_ERR << "Failed to parse value for merge" << std::endl;
                 compoundStack.pop_back();
                 return nullptr;
             }
+            if (entry->getType() != EntryType::Function && this->captures == captures) {
+                // the value of a statement is not kept, unless a function declared while it ran may still see it
+                delete entry;
+            }
             i++;
-            if (i >= tokens.size() || tokens[i].type != Token::BlockEnd) {
+            if (!tokens.has(i) || tokens[i].type != Token::BlockEnd) {
                 LYNX_ERR << "Invalid block end" << std::endl;
                 compoundStack.pop_back();
                 return nullptr;
@@ -418,13 +618,20 @@ CompoundEntry* ConfigParser::parseCompound(std::vector<Token>& tokens, int& i, s
             continue;
         }
         if (tokens[i].type != Token::Identifier) {
-            LYNX_ERR << "Invalid key: " << tokens[i].value << std::endl;
+            LYNX_ERR << "Invalid key: " << tokens.value(i) << std::endl;
+            compoundStack.pop_back();
+            return nullptr;
+        }
+        Symbol key = tokens[i].symbol;
+        bool redeclared = this->lazy && declared(compoundStack, key);
+        if (redeclared && !this->pending.empty() && !this->forcePending(compound)) {
+            // a name declared again must not change what the values declared before see
+            LYNX_ERR << "Failed to evaluate the values before key '" << key << "'" << std::endl;
             compoundStack.pop_back();
             return nullptr;
         }
-        std::string key = tokens[i].value;
         i++;
-        if (i < tokens.size() && tokens[i].type == Token::Is) {
+        if (tokens.has(i) && tokens[i].type == Token::Is) {
             i++;
             Type* type = parseType(tokens, i, compoundStack);
             if (!type) {
@@ -445,17 +652,45 @@ CompoundEntry* ConfigParser::parseCompound(std::vector<Token>& tokens, int& i, s
             }
             compound->add(entry);
             i++;
-            if (i >= tokens.size() || tokens[i].type != Token::Assign) {
+            if (!tokens.has(i) || tokens[i].type != Token::Assign) {
                 continue;
             }
-        } else if (i >= tokens.size() || tokens[i].type != Token::Assign) {
-            LYNX_ERR << "Invalid assignment: " << tokens[i].value << " in key '" << key << "'" << std::endl;
+        } else if (!tokens.has(i) || tokens[i].type != Token::Assign) {
+            LYNX_ERR << "Invalid assignment: " << tokens.value(i) << " in key '" << key << "'" << std::endl;
             compoundStack.pop_back();
             return nullptr;
         }
         i++;
         
-        ConfigEntry* entry = parseValue(tokens, i, compoundStack);
+        ConfigEntry* entry = nullptr;
+        if (this->lazy) {
+            // looking for the end of the value lexes ahead, the value is read again if it cannot be deferred
+            tokens.pin(i);
+            this->declaring.push_back(key);
+            ThunkEntry* thunk = redeclared || !compound->lasting ? nullptr : this->defer(tokens, i, compoundStack);
+            if (thunk) {
+                this->declaring.pop_back();
+                tokens.unpin();
+                thunk->setKey(key);
+                ConfigEntry* current = compound->get(key);
+                if (current && current->getType() == EntryType::Type) {
+                    thunk->type = (TypeEntry*) current;
+                }
+                compound->add(thunk);
+                i++;
+                continue;
+            }
+            // the value of a name declared again may still see the old one, through a function too, which is
+            // gone once it is replaced
+            this->lazy = !redeclared;
+            this->member = tokens[i].type == Token::CompoundStart;
+            entry = parseValue(tokens, i, compoundStack);
+            this->lazy = true;
+            this->declaring.pop_back();
+            tokens.unpin();
+        } else {
+            entry = parseValue(tokens, i, compoundStack);
+        }
         if (!entry) {
             LYNX_ERR << "Failed to parse value for key '" << key << "'" << std::endl;
             compoundStack.pop_back();
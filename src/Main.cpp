@@ -1,4 +1,10 @@
 #include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <filesystem>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 #include <LynxConf.hpp>
 
@@ -8,11 +14,87 @@ int main(int argc, char const *argv[]) {
     }
 
     std::string file = argv[1];
-    auto parsed = ConfigParser().parse(file);
+    if (FrozenConfig::isImage(file)) {
+        // written by LYNX_EMIT, queried without parsing anything
+        FrozenConfig* image = FrozenConfig::load(file);
+        if (image) {
+            if (argc > 2) {
+                FrozenEntry entry = image->root().getByPath(argv[2]);
+                if (!entry.exists()) {
+                    std::cerr << "Failed to find entry: " << argv[2] << std::endl;
+                    return 1;
+                }
+                entry.print(std::cout);
+            }
+            return 0;
+        }
+        // a damaged image is answered from the file it was written from, if that is still there
+        std::string source = FrozenConfig::source(file);
+        if (source.empty() || !std::filesystem::exists(source)) {
+            std::cerr << "Failed to load image: " << file << std::endl;
+            return 1;
+        }
+        std::cerr << "Parsing " << source << " instead of image: " << file << std::endl;
+        file = source;
+    }
+    ConfigParser parser;
+    const char* cacheDir = getenv("LYNX_CACHE");
+    if (cacheDir && *cacheDir) {
+        parser.cache = new ParseCache(cacheDir);
+    }
+    const char* engine = getenv("LYNX_ENGINE");
+    if (engine && std::string(engine) == "vm") {
+        parser.vm = true;
+    }
+    const char* lazy = getenv("LYNX_LAZY");
+    if (argc > 2 && lazy && std::string(lazy) == "1") {
+        // only the values the path needs are evaluated
+        parser.lazy = true;
+    }
+    const char* memoize = getenv("LYNX_MEMO");
+    if (memoize && std::string(memoize) == "0") {
+        parser.memoize = false;
+    }
+    const char* optimize = getenv("LYNX_OPT");
+    if (optimize && std::string(optimize) == "0") {
+        parser.optimize = false;
+    } else if (optimize && std::string(optimize) == "verbose") {
+        parser.explain = true;
+    }
+    auto parsed = parser.parse(file);
+    if (parser.cache && getenv("LYNX_CACHE_STATS")) {
+        std::cerr << "[Lynx Config] Parse cache: " << parser.cache->hits << " hits, " << parser.cache->misses << " misses" << std::endl;
+    }
+    if (getenv("LYNX_STATS")) {
+        std::cerr << "[Lynx Config] Clones: " << ConfigEntry::clones << " entries, " << ConfigEntry::copies << " shared lists and compounds copied" << std::endl;
+        std::cerr << "[Lynx Config] Arena: " << parser.arena.allocations << " allocations, " << parser.arena.reused << " reused, " << parser.arena.reserved / 1024 << " KB reserved" << std::endl;
+        std::cerr << "[Lynx Config] Memo: " << parser.memoHits << " hits, " << parser.memoMisses << " misses" << std::endl;
+#ifndef _WIN32
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        long peak = usage.ru_maxrss;
+#ifdef __APPLE__
+        // bytes on macOS, kilobytes everywhere else
+        peak /= 1024;
+#endif
+        std::cerr << "[Lynx Config] Peak memory: " << peak << " KB" << std::endl;
+#endif
+    }
     if (!parsed) {
         std::cerr << "Failed to parse file: " << file << std::endl;
         return 1;
     }
+    const char* emit = getenv("LYNX_EMIT");
+    if (emit && *emit) {
+        if (parsed->getType() != EntryType::Compound) {
+            std::cerr << "Invalid entry type. Expected Compound but got " << parsed->getType() << std::endl;
+            return 1;
+        }
+        FrozenConfig* image = static_cast<CompoundEntry*>(parsed)->freeze();
+        if (!image->write(emit, std::filesystem::absolute(file).string())) {
+            return 1;
+        }
+    }
     if (argc > 2) {
         std::string path = argv[2];
         if (parsed->getType() != EntryType::Compound) {
@@ -24,7 +106,14 @@ int main(int argc, char const *argv[]) {
             std::cerr << "Failed to find entry: " << path << std::endl;
             return 1;
         }
-        entry->print(std::cout);
+        // printing evaluates the deferred values in the entry, nothing is printed if one of them fails
+        std::ostringstream out;
+        entry->print(out);
+        if (parser.failures) {
+            std::cerr << "Failed to evaluate entry: " << path << std::endl;
+            return 1;
+        }
+        std::cout << out.str();
     }
     return 0;
 }
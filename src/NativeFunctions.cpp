@@ -1,5 +1,6 @@
 #include <LynxConf.hpp>
 
+#include <algorithm>
 #include <memory>
 #include <cstdio>
 #include <cmath>
@@ -22,8 +23,8 @@ static void recursiveDelete(std::string path) {
 }
 
 std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
-    std::pair("runshell", new NativeFunctionEntry({{"command", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* command = args->getString("command");
+    std::pair("runshell", new NativeFunctionEntry({{"command", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* command = ((StringEntry*) args[0]);
         if (!command) {
             std::cerr << "Failed to parse runshell block" << std::endl;
             return nullptr;
@@ -42,8 +43,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         entry->setValue(resultStr);
         return ((ConfigEntry*) entry);
     })),
-    std::pair("print", new NativeFunctionEntry({{"value", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        ConfigEntry* result = args->get("value");
+    std::pair("print", new NativeFunctionEntry({{"value", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        ConfigEntry* result = args[0];
         if (!result) {
             std::cerr << "Failed to parse print block" << std::endl;
             return nullptr;
@@ -59,8 +60,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         }
         return result;
     })),
-    std::pair("use", new NativeFunctionEntry({{"file", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* result = args->getString("file");
+    std::pair("use", new NativeFunctionEntry({{"file", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* result = ((StringEntry*) args[0]);
         if (!result) {
             std::cerr << "Failed to parse use block" << std::endl;
             return nullptr;
@@ -83,15 +84,18 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
             std::cerr << "Failed to parse file '" << file << "'" << std::endl;
             return nullptr;
         }
-        if (compoundStack.size() < 2) {
+        if (compoundStack.empty()) {
             std::cerr << "Invalid compound stack size: " << compoundStack.size() << std::endl;
             return nullptr;
         }
-        compoundStack.at(compoundStack.size() - 2)->merge(entry);
+        // the arguments are not on the stack, the file is merged into the compound of the caller
+        compoundStack.back()->merge(entry);
+        // the functions of the file keep its compound on their stack, so it is never freed
+        parser->captures++;
         return ((ConfigEntry*) entry);
     })),
-    std::pair("printLn", new NativeFunctionEntry({{"value", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        ConfigEntry* result = args->get("value");
+    std::pair("printLn", new NativeFunctionEntry({{"value", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        ConfigEntry* result = args[0];
         if (!result) {
             std::cerr << "Failed to parse printLn block" << std::endl;
             return nullptr;
@@ -108,16 +112,16 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         std::cout << std::endl;
         return result;
     })),
-    std::pair("readLn", new NativeFunctionEntry({}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
+    std::pair("readLn", new NativeFunctionEntry({}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
         std::string line;
         std::getline(std::cin, line);
         StringEntry* entry = new StringEntry();
         entry->setValue(line);
         return ((ConfigEntry*) entry);
     })),
-    std::pair("eq", new NativeFunctionEntry({{"a", Type::Any()}, {"b", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        ConfigEntry* entryA = args->get("a");
-        ConfigEntry* entryB = args->get("b");
+    std::pair("eq", new NativeFunctionEntry({{"a", Type::Any()}, {"b", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        ConfigEntry* entryA = args[0];
+        ConfigEntry* entryB = args[1];
         if (!entryA || !entryB) {
             std::cerr << "Failed to parse eq block" << std::endl;
             return nullptr;
@@ -125,10 +129,10 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         NumberEntry* result = new NumberEntry();
         result->setValue(entryA->getType() == entryB->getType() && entryA->operator==(*entryB) ? 1 : 0);
         return ((ConfigEntry*) result);
-    })),
-    std::pair("ne", new NativeFunctionEntry({{"a", Type::Any()}, {"b", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        ConfigEntry* entryA = args->get("a");
-        ConfigEntry* entryB = args->get("b");
+    }, true)),
+    std::pair("ne", new NativeFunctionEntry({{"a", Type::Any()}, {"b", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        ConfigEntry* entryA = args[0];
+        ConfigEntry* entryB = args[1];
         if (!entryA || !entryB) {
             std::cerr << "Failed to parse ne block" << std::endl;
             return nullptr;
@@ -136,9 +140,9 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         NumberEntry* result = new NumberEntry();
         result->setValue(entryA->getType() != entryB->getType() || !entryA->operator==(*entryB) ? 1 : 0);
         return ((ConfigEntry*) result);
-    })),
-    std::pair("string-length", new NativeFunctionEntry({{"value", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* entry = args->getString("value");
+    }, true)),
+    std::pair("string-length", new NativeFunctionEntry({{"value", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* entry = ((StringEntry*) args[0]);
         if (!entry) {
             std::cerr << "Failed to parse string-length block" << std::endl;
             return nullptr;
@@ -146,11 +150,11 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         NumberEntry* result = new NumberEntry();
         result->setValue(entry->getValue().length());
         return ((ConfigEntry*) result);
-    })),
-    std::pair("string-substring", new NativeFunctionEntry({{"string", Type::String()}, {"start", Type::Number()}, {"end", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* str = args->getString("string");
-        NumberEntry* start = args->getNumber("start");
-        NumberEntry* end = args->getNumber("end");
+    }, true)),
+    std::pair("string-substring", new NativeFunctionEntry({{"string", Type::String()}, {"start", Type::Number()}, {"end", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* str = ((StringEntry*) args[0]);
+        NumberEntry* start = ((NumberEntry*) args[1]);
+        NumberEntry* end = ((NumberEntry*) args[2]);
         if (!str || !start || !end) {
             std::cerr << "Failed to parse string-substring block" << std::endl;
             return nullptr;
@@ -165,12 +169,12 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         StringEntry* result = new StringEntry();
         result->setValue(value.substr(startValue, endValue - startValue));
         return ((ConfigEntry*) result);
-    })),
+    }, true)),
 
 #define BINARY_OP(_name, _op) \
-    std::pair(_name, new NativeFunctionEntry({{"a", Type::Number()}, {"b", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* { \
-        NumberEntry* entryA = args->getNumber("a"); \
-        NumberEntry* entryB = args->getNumber("b"); \
+    std::pair(_name, new NativeFunctionEntry({{"a", Type::Number()}, {"b", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* { \
+        NumberEntry* entryA = ((NumberEntry*) args[0]); \
+        NumberEntry* entryB = ((NumberEntry*) args[1]); \
         if (!entryA || !entryB) { \
             std::cerr << "Failed to parse " _name " block" << std::endl; \
             return nullptr; \
@@ -178,7 +182,7 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         NumberEntry* result = new NumberEntry(); \
         result->setValue(entryA->getValue() _op entryB->getValue()); \
         return ((ConfigEntry*) result); \
-    })),
+    }, true)),
 
     BINARY_OP("add", +)
     BINARY_OP("sub", -)
@@ -193,8 +197,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
 
 #undef BINARY_OP
 #define UNARY_OP(_name, _op) \
-    std::pair(_name, new NativeFunctionEntry({{"value", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* { \
-        NumberEntry* entry = args->getNumber("value"); \
+    std::pair(_name, new NativeFunctionEntry({{"value", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* { \
+        NumberEntry* entry = ((NumberEntry*) args[0]); \
         if (!entry) { \
             std::cerr << "Failed to parse " _name " block" << std::endl; \
             return nullptr; \
@@ -206,14 +210,14 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         NumberEntry* result = new NumberEntry(); \
         result->setValue(_op entry->getValue()); \
         return ((ConfigEntry*) result); \
-    })),
+    }, true)),
 
     UNARY_OP("not", !)
     
 #undef UNARY_OP
-    std::pair("mod", new NativeFunctionEntry({{"a", Type::Number()}, {"b", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        NumberEntry* entryA = args->getNumber("a");
-        NumberEntry* entryB = args->getNumber("b");
+    std::pair("mod", new NativeFunctionEntry({{"a", Type::Number()}, {"b", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        NumberEntry* entryA = ((NumberEntry*) args[0]);
+        NumberEntry* entryB = ((NumberEntry*) args[1]);
         if (!entryA || !entryB) {
             std::cerr << "Failed to parse modulo block" << std::endl;
             return nullptr;
@@ -221,10 +225,10 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         NumberEntry* result = new NumberEntry();
         result->setValue(std::fmod(entryA->getValue(), entryB->getValue()));
         return ((ConfigEntry*) result);
-    })),
-    std::pair("shl", new NativeFunctionEntry({{"a", Type::Number()}, {"b", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        NumberEntry* entryA = args->getNumber("a");
-        NumberEntry* entryB = args->getNumber("b");
+    }, true)),
+    std::pair("shl", new NativeFunctionEntry({{"a", Type::Number()}, {"b", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        NumberEntry* entryA = ((NumberEntry*) args[0]);
+        NumberEntry* entryB = ((NumberEntry*) args[1]);
         if (!entryA || !entryB) {
             std::cerr << "Failed to parse left shift block" << std::endl;
             return nullptr;
@@ -232,10 +236,10 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         NumberEntry* result = new NumberEntry();
         result->setValue((long long) entryA->getValue() << (long long) entryB->getValue());
         return ((ConfigEntry*) result);
-    })),
-    std::pair("shr", new NativeFunctionEntry({{"a", Type::Number()}, {"b", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        NumberEntry* entryA = args->getNumber("a");
-        NumberEntry* entryB = args->getNumber("b");
+    }, true)),
+    std::pair("shr", new NativeFunctionEntry({{"a", Type::Number()}, {"b", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        NumberEntry* entryA = ((NumberEntry*) args[0]);
+        NumberEntry* entryB = ((NumberEntry*) args[1]);
         if (!entryA || !entryB) {
             std::cerr << "Failed to parse right shift block" << std::endl;
             return nullptr;
@@ -243,10 +247,10 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         NumberEntry* result = new NumberEntry();
         result->setValue((long long) entryA->getValue() >> (long long) entryB->getValue());
         return ((ConfigEntry*) result);
-    })),
-    std::pair("range", new NativeFunctionEntry({{"a", Type::Number()}, {"b", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        NumberEntry* entryA = args->getNumber("a");
-        NumberEntry* entryB = args->getNumber("b");
+    }, true)),
+    std::pair("range", new NativeFunctionEntry({{"a", Type::Number()}, {"b", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        NumberEntry* entryA = ((NumberEntry*) args[0]);
+        NumberEntry* entryB = ((NumberEntry*) args[1]);
         if (!entryA || !entryB) {
             std::cerr << "Failed to parse range block" << std::endl;
             return nullptr;
@@ -254,15 +258,18 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         ListEntry* result = new ListEntry();
         long long start = entryA->getValue();
         long long end = entryB->getValue();
+        if (end > start) {
+            result->reserve(end - start);
+        }
         for (long long i = start; i < end; i++) {
             NumberEntry* entry = new NumberEntry();
             entry->setValue(i);
             result->add(((ConfigEntry*) entry));
         }
         return ((ConfigEntry*) result);
-    })),
-    std::pair("list-length", new NativeFunctionEntry({{"list", Type::List(Type::Any())}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        ListEntry* list = args->getList("list");
+    }, true)),
+    std::pair("list-length", new NativeFunctionEntry({{"list", Type::List(Type::Any())}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        ListEntry* list = ((ListEntry*) args[0]);
         if (!list) {
             std::cerr << "Failed to parse list" << std::endl;
             return nullptr;
@@ -270,14 +277,14 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         NumberEntry* result = new NumberEntry();
         result->setValue(list->size());
         return ((ConfigEntry*) result);
-    })),
-    std::pair("list-get", new NativeFunctionEntry({{"list", Type::List(Type::Any())}, {"index", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        ListEntry* list = args->getList("list");
+    }, true)),
+    std::pair("list-get", new NativeFunctionEntry({{"list", Type::List(Type::Any())}, {"index", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        ListEntry* list = ((ListEntry*) args[0]);
         if (!list) {
             std::cerr << "Failed to parse list" << std::endl;
             return nullptr;
         }
-        NumberEntry* index = args->getNumber("index");
+        NumberEntry* index = ((NumberEntry*) args[1]);
         if (!index) {
             std::cerr << "Failed to parse index" << std::endl;
             return nullptr;
@@ -288,19 +295,19 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
             return nullptr;
         }
         return list->get(idx)->clone();
-    })),
-    std::pair("list-set", new NativeFunctionEntry({{"list", Type::List(Type::Any())}, {"index", Type::Number()}, {"value", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        ListEntry* list = args->getList("list");
+    }, true)),
+    std::pair("list-set", new NativeFunctionEntry({{"list", Type::List(Type::Any())}, {"index", Type::Number()}, {"value", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        ListEntry* list = ((ListEntry*) args[0]);
         if (!list) {
             std::cerr << "Failed to parse list" << std::endl;
             return nullptr;
         }
-        NumberEntry* index = args->getNumber("index");
+        NumberEntry* index = ((NumberEntry*) args[1]);
         if (!index) {
             std::cerr << "Failed to parse index" << std::endl;
             return nullptr;
         }
-        ConfigEntry* value = args->get("value");
+        ConfigEntry* value = args[2];
         if (!value) {
             std::cerr << "Failed to parse value" << std::endl;
             return nullptr;
@@ -315,14 +322,14 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
             return nullptr;
         }
         return list->operator[](idx) = value->clone();
-    })),
-    std::pair("list-append", new NativeFunctionEntry({{"list", Type::List(Type::Any())}, {"value", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        ListEntry* list = args->getList("list");
+    }, true)),
+    std::pair("list-append", new NativeFunctionEntry({{"list", Type::List(Type::Any())}, {"value", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        ListEntry* list = ((ListEntry*) args[0]);
         if (!list) {
             std::cerr << "Failed to parse list" << std::endl;
             return nullptr;
         }
-        ConfigEntry* value = args->get("value");
+        ConfigEntry* value = args[1];
         if (!value) {
             std::cerr << "Failed to parse value" << std::endl;
             return nullptr;
@@ -333,14 +340,14 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         }
         list->add(value->clone());
         return new StringEntry();
-    })),
-    std::pair("list-remove", new NativeFunctionEntry({{"list", Type::List(Type::Any())}, {"index", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        ListEntry* list = args->getList("list");
+    }, true)),
+    std::pair("list-remove", new NativeFunctionEntry({{"list", Type::List(Type::Any())}, {"index", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        ListEntry* list = ((ListEntry*) args[0]);
         if (!list) {
             std::cerr << "Failed to parse list" << std::endl;
             return nullptr;
         }
-        NumberEntry* index = args->getNumber("index");
+        NumberEntry* index = ((NumberEntry*) args[1]);
         if (!index) {
             std::cerr << "Failed to parse index" << std::endl;
             return nullptr;
@@ -352,9 +359,9 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         }
         list->remove(idx);
         return new StringEntry();
-    })),
-    std::pair("inc", new NativeFunctionEntry({{"value", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        NumberEntry* value = args->getNumber("value");
+    }, true)),
+    std::pair("inc", new NativeFunctionEntry({{"value", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        NumberEntry* value = ((NumberEntry*) args[0]);
         if (!value) {
             std::cerr << "Failed to parse inc block" << std::endl;
             return nullptr;
@@ -362,9 +369,9 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         NumberEntry* result = new NumberEntry();
         result->setValue(value->getValue() + 1);
         return ((ConfigEntry*) result);
-    })),
-    std::pair("dec", new NativeFunctionEntry({{"value", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        NumberEntry* value = args->getNumber("value");
+    }, true)),
+    std::pair("dec", new NativeFunctionEntry({{"value", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        NumberEntry* value = ((NumberEntry*) args[0]);
         if (!value) {
             std::cerr << "Failed to parse dec block" << std::endl;
             return nullptr;
@@ -372,9 +379,9 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         NumberEntry* result = new NumberEntry();
         result->setValue(value->getValue() - 1);
         return ((ConfigEntry*) result);
-    })),
-    std::pair("exit", new NativeFunctionEntry({{"value", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        NumberEntry* value = args->getNumber("value");
+    }, true)),
+    std::pair("exit", new NativeFunctionEntry({{"value", Type::Number()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        NumberEntry* value = ((NumberEntry*) args[0]);
         if (!value) {
             std::cerr << "Failed to parse exit block" << std::endl;
             return nullptr;
@@ -383,8 +390,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         std::exit(exitCode);
         return new StringEntry();
     })),
-    std::pair("file-mkdir", new NativeFunctionEntry({{"path", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* str = args->getString("path");
+    std::pair("file-mkdir", new NativeFunctionEntry({{"path", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* str = ((StringEntry*) args[0]);
         if (!str) {
             std::cerr << "Failed to parse file-mkdir block" << std::endl;
             return nullptr;
@@ -407,8 +414,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         }
         return new StringEntry();
     })),
-    std::pair("file-rmdir", new NativeFunctionEntry({{"path", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* str = args->getString("path");
+    std::pair("file-rmdir", new NativeFunctionEntry({{"path", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* str = ((StringEntry*) args[0]);
         if (!str) {
             std::cerr << "Failed to parse file-rmdir block" << std::endl;
             return nullptr;
@@ -424,8 +431,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         recursiveDelete(str->getValue());
         return new StringEntry();
     })),
-    std::pair("file-remove", new NativeFunctionEntry({{"path", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* str = args->getString("path");
+    std::pair("file-remove", new NativeFunctionEntry({{"path", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* str = ((StringEntry*) args[0]);
         if (!str) {
             std::cerr << "Failed to parse file-remove block" << std::endl;
             return nullptr;
@@ -441,8 +448,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         std::filesystem::remove(str->getValue());
         return new StringEntry();
     })),
-    std::pair("file-write", new NativeFunctionEntry({{"path", Type::String()}, {"content", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* path = args->getString("path");
+    std::pair("file-write", new NativeFunctionEntry({{"path", Type::String()}, {"content", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* path = ((StringEntry*) args[0]);
         if (!path) {
             std::cerr << "Failed to parse file-write block" << std::endl;
             return nullptr;
@@ -451,7 +458,7 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
             std::cerr << "Invalid path in file-write block" << std::endl;
             return nullptr;
         }
-        StringEntry* content = args->getString("content");
+        StringEntry* content = ((StringEntry*) args[1]);
         if (!content) {
             std::cerr << "Failed to parse content in file-write block" << std::endl;
             return nullptr;
@@ -481,8 +488,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         result->setValue(path->getValue());
         return ((ConfigEntry*) result);
     })),
-    std::pair("file-read", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* filename = args->getString("filename");
+    std::pair("file-read", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* filename = ((StringEntry*) args[0]);
         if (!filename) {
             std::cerr << "Failed to parse file-read block" << std::endl;
             return nullptr;
@@ -506,8 +513,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         result->setValue(content);
         return ((ConfigEntry*) result);
     })),
-    std::pair("file-exists", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* filename = args->getString("filename");
+    std::pair("file-exists", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* filename = ((StringEntry*) args[0]);
         if (!filename) {
             std::cerr << "Failed to parse file-exists block" << std::endl;
             return nullptr;
@@ -520,8 +527,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         result->setValue(std::filesystem::exists(filename->getValue()) ? 1 : 0);
         return ((ConfigEntry*) result);
     })),
-    std::pair("file-isdir", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* filename = args->getString("filename");
+    std::pair("file-isdir", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* filename = ((StringEntry*) args[0]);
         if (!filename) {
             std::cerr << "Failed to parse file-isdir block" << std::endl;
             return nullptr;
@@ -534,8 +541,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         result->setValue(std::filesystem::is_directory(filename->getValue()) ? 1 : 0);
         return ((ConfigEntry*) result);
     })),
-    std::pair("file-isfile", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* filename = args->getString("filename");
+    std::pair("file-isfile", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* filename = ((StringEntry*) args[0]);
         if (!filename) {
             std::cerr << "Failed to parse file-isfile block" << std::endl;
             return nullptr;
@@ -548,8 +555,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         result->setValue(std::filesystem::is_regular_file(filename->getValue()) ? 1 : 0);
         return ((ConfigEntry*) result);
     })),
-    std::pair("file-dirname", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* filename = args->getString("filename");
+    std::pair("file-dirname", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* filename = ((StringEntry*) args[0]);
         if (!filename) {
             std::cerr << "Failed to parse file-dirname block" << std::endl;
             return nullptr;
@@ -562,8 +569,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         result->setValue(std::filesystem::path(filename->getValue()).parent_path().string());
         return ((ConfigEntry*) result);
     })),
-    std::pair("file-basename", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* filename = args->getString("filename");
+    std::pair("file-basename", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* filename = ((StringEntry*) args[0]);
         if (!filename) {
             std::cerr << "Failed to parse file-basename block" << std::endl;
             return nullptr;
@@ -576,8 +583,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         result->setValue(std::filesystem::path(filename->getValue()).filename().string());
         return ((ConfigEntry*) result);
     })),
-    std::pair("file-extname", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* filename = args->getString("filename");
+    std::pair("file-extname", new NativeFunctionEntry({{"filename", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* filename = ((StringEntry*) args[0]);
         if (!filename) {
             std::cerr << "Failed to parse file-extname block" << std::endl;
             return nullptr;
@@ -590,8 +597,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         result->setValue(std::filesystem::path(filename->getValue()).extension().string());
         return ((ConfigEntry*) result);
     })),
-    std::pair("file-copy", new NativeFunctionEntry({{"from", Type::String()}, {"to", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        StringEntry* from = args->getString("from");
+    std::pair("file-copy", new NativeFunctionEntry({{"from", Type::String()}, {"to", Type::String()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        StringEntry* from = ((StringEntry*) args[0]);
         if (!from) {
             std::cerr << "Failed to parse file-copy block" << std::endl;
             return nullptr;
@@ -600,7 +607,7 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
             std::cerr << "Invalid from path in file-copy block" << std::endl;
             return nullptr;
         }
-        StringEntry* to = args->getString("to");
+        StringEntry* to = ((StringEntry*) args[1]);
         if (!to) {
             std::cerr << "Failed to parse file-copy block" << std::endl;
             return nullptr;
@@ -649,8 +656,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
             return nullptr;
         }
     })),
-    std::pair("printErr", new NativeFunctionEntry({{"value", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        ConfigEntry* result = args->get("value");
+    std::pair("printErr", new NativeFunctionEntry({{"value", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        ConfigEntry* result = args[0];
         if (!result) {
             std::cerr << "Failed to parse printErr block" << std::endl;
             return nullptr;
@@ -666,8 +673,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         }
         return result;
     })),
-    std::pair("printErrLn", new NativeFunctionEntry({{"value", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
-        ConfigEntry* result = args->get("value");
+    std::pair("printErrLn", new NativeFunctionEntry({{"value", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
+        ConfigEntry* result = args[0];
         if (!result) {
             std::cerr << "Failed to parse printErrLn block" << std::endl;
             return nullptr;
@@ -684,10 +691,10 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         std::cerr << std::endl;
         return result;
     })),
-    std::pair("ignore", new NativeFunctionEntry({{"_", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
+    std::pair("ignore", new NativeFunctionEntry({{"_", Type::Any()}}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
         return new StringEntry();
-    })),
-    std::pair("os-name", new NativeFunctionEntry({}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
+    }, true)),
+    std::pair("os-name", new NativeFunctionEntry({}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
         #ifdef _WIN32
             const char osName[] = "Windows";
         #elif __APPLE__ || __MACH__
@@ -704,8 +711,8 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         StringEntry* result = new StringEntry();
         result->setValue(std::string(osName));
         return ((ConfigEntry*) result);
-    })),
-    std::pair("os-arch", new NativeFunctionEntry({}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, CompoundEntry* args) -> ConfigEntry* {
+    }, true)),
+    std::pair("os-arch", new NativeFunctionEntry({}, [](ConfigParser* parser, std::vector<CompoundEntry*>& compoundStack, ConfigEntry** args) -> ConfigEntry* {
         #if defined(__x86_64__) || defined(_M_X64)
             const char osArch[] = "x86_64";
         #elif defined(__i386__) || defined(_M_IX86)
@@ -720,5 +727,36 @@ std::unordered_map<std::string, NativeFunctionEntry*> nativeFunctions {
         StringEntry* result = new StringEntry();
         result->setValue(std::string(osArch));
         return ((ConfigEntry*) result);
-    })),
+    }, true)),
+};
+
+// The native functions by symbol id, less the id of the first one, built like the table of builtins.
+struct NativeTable {
+    uint32_t first = 0;
+    std::vector<NativeFunctionEntry*> functions;
 };
+
+static NativeTable buildNativeTable() {
+    NativeTable table;
+    std::vector<std::pair<Symbol, NativeFunctionEntry*>> named;
+    for (auto& native : nativeFunctions) {
+        named.emplace_back(Symbol(native.first), native.second);
+    }
+    table.first = UINT32_MAX;
+    uint32_t last = 0;
+    for (auto& native : named) {
+        table.first = std::min(table.first, native.first.id);
+        last = std::max(last, native.first.id);
+    }
+    table.functions.resize(last - table.first + 1);
+    for (auto& native : named) {
+        table.functions[native.first.id - table.first] = native.second;
+    }
+    return table;
+}
+
+NativeFunctionEntry* findNative(Symbol name) {
+    static const NativeTable table = buildNativeTable();
+    uint32_t index = name.id - table.first;
+    return index < table.functions.size() ? table.functions[index] : nullptr;
+}
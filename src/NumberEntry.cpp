@@ -34,7 +34,8 @@ void NumberEntry::print(std::ostream& stream, int indent) const {
 
 ConfigEntry* NumberEntry::clone() {
     NumberEntry* entry = new NumberEntry();
-    entry->setKey(this->getKey());
+    entry->setKey(this->getSymbol());
+    ConfigEntry::clones++;
     entry->setValue(this->value);
     return ((ConfigEntry*) entry);
 }
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <sstream>
+
+#include <LynxConf.hpp>
+
+#pragma region Folding
+// Returns the index of the last token of the constant expression starting at the specified token, or -1 if it is
+// not one. Natives are found by name before any scope is searched, so a call of one always means the same.
+static int constantEnd(TokenList& tokens, int i) {
+    if (!tokens.has(i)) {
+        return -1;
+    }
+    switch (tokens[i].type) {
+        case Token::String:
+        case Token::Number:
+            return i;
+        case Token::BlockStart: {
+            int end = constantEnd(tokens, i + 1);
+            return end >= 0 && tokens.has(end + 1) && tokens[end + 1].type == Token::BlockEnd ? end + 1 : -1;
+        }
+        case Token::Identifier: {
+            Symbol name = tokens[i].symbol;
+            if (tokens.has(i + 1) && tokens[i + 1].type == Token::Dot) {
+                return -1;
+            }
+            if (name == Symbol("true") || name == Symbol("false")) {
+                return i;
+            }
+            NativeFunctionEntry* native = findNative(name);
+            if (!native || !native->isPure) {
+                return -1;
+            }
+            int end = i;
+            for (size_t n = 0; n < native->args.size(); n++) {
+                // named arguments are not folded
+                end = constantEnd(tokens, end + 1);
+                if (end < 0) {
+                    return -1;
+                }
+            }
+            return end;
+        }
+        default:
+            return -1;
+    }
+}
+
+ConfigEntry* ConfigParser::fold(TokenList& tokens, int& i) {
+    if (!this->optimize || !tokens.has(i) || tokens[i].type != Token::Identifier || findBuiltin(tokens[i].symbol)) {
+        return nullptr;
+    }
+    int end = constantEnd(tokens, i);
+    if (end < 0) {
+        return nullptr;
+    }
+    // a call that fails reports its error when it runs instead, type errors are reported on the standard output
+    std::streambuf* errors = std::cerr.rdbuf(nullptr);
+    std::streambuf* output = std::cout.rdbuf(nullptr);
+    int at = i;
+    std::vector<CompoundEntry*> compoundStack;
+    ConfigEntry* value = this->parseToken(tokens, at, compoundStack);
+    std::cerr.rdbuf(errors);
+    std::cerr.clear();
+    std::cout.rdbuf(output);
+    std::cout.clear();
+    if (value && (at != end || (value->getType() != EntryType::String && value->getType() != EntryType::Number))) {
+        // lists and compounds would have to be copied every time they are used
+        delete value;
+        value = nullptr;
+    }
+    if (!value) {
+        return nullptr;
+    }
+    if (this->explain) {
+        std::ostringstream result;
+        if (value->getType() == EntryType::String) {
+            result << " to \"" << ((StringEntry*) value)->getValue() << "\"";
+        } else {
+            result << " to " << ((NumberEntry*) value)->getValue();
+        }
+        this->optimized(tokens, i, end, "folded", result.str());
+    }
+    i = end;
+    return value;
+}
+#pragma endregion
+
+void ConfigParser::optimized(TokenList& tokens, int from, int to, const std::string& change, const std::string& result) {
+    if (!this->explain) {
+        return;
+    }
+    std::ostringstream message;
+    message << "[Lynx Config] " << tokens.location(from) << ": " << change << " '";
+    for (int k = from; k <= to; k++) {
+        if (k > from && tokens[k].type != Token::Dot && tokens[k - 1].type != Token::Dot && tokens[k - 1].type != Token::BlockStart && tokens[k].type != Token::BlockEnd) {
+            message << " ";
+        }
+        if (tokens[k].type == Token::String) {
+            message << "\"" << tokens.value(k) << "\"";
+        } else {
+            message << tokens.value(k);
+        }
+    }
+    message << "'" << result;
+    if (this->explained.insert(message.str()).second) {
+        std::cerr << message.str() << std::endl;
+    }
+}
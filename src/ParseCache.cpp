@@ -0,0 +1,173 @@
+#include <LynxConf.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+// Bump when the layout of a cache entry or the packed token form changes.
+#define CACHE_FORMAT 2
+
+// A cache entry is a header followed by the packed tokens, the escapes, the line
+// table and the decoded string table of a file, written in host byte order.
+struct CacheHeader {
+    char magic[8];
+    uint32_t format;
+    uint32_t reserved;
+    uint64_t hash;
+    uint64_t size;
+    uint64_t checksum;
+    uint32_t packed;
+    uint32_t escapes;
+    uint32_t lines;
+    uint32_t strings;
+};
+
+static const char cacheMagic[8] = {'L', 'Y', 'N', 'X', 'T', 'O', 'K', '\0'};
+
+static uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Hashes data eight bytes at a time, starting from the specified state.
+static uint64_t hashBytes(uint64_t h, std::string_view data) {
+    size_t i = 0;
+    for (; i + 8 <= data.size(); i += 8) {
+        uint64_t word;
+        memcpy(&word, data.data() + i, 8);
+        h = (h ^ word) * 0x100000001b3ull;
+        h ^= h >> 29;
+    }
+    for (; i < data.size(); i++) {
+        h = (h ^ (uint8_t) data[i]) * 0x100000001b3ull;
+    }
+    return mix(h ^ data.size());
+}
+
+// Hashes the contents of a file together with the lynx version.
+static uint64_t contentHash(std::string_view data) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (const char* v = LYNX_VERSION; *v; v++) {
+        h = (h ^ (uint8_t) *v) * 0x100000001b3ull;
+    }
+    return hashBytes(h, data);
+}
+
+static std::string entryPath(const std::string& directory, uint64_t hash) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.tok", (unsigned long long) hash);
+    return (std::filesystem::path(directory) / name).string();
+}
+
+ParseCache::ParseCache(const std::string& directory) {
+    this->directory = directory;
+}
+
+bool ParseCache::load(SourceTable* sources, uint32_t file, TokenStream& stream) {
+    SourceFile& src = sources->files[file];
+    uint64_t hash = contentHash(src.data);
+    FILE* fp = fopen(entryPath(this->directory, hash).c_str(), "rb");
+    if (!fp) {
+        this->misses++;
+        return false;
+    }
+    std::string data;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        long size = ftell(fp);
+        rewind(fp);
+        if (size > 0) {
+            data.resize(size);
+            data.resize(fread(data.data(), 1, size, fp));
+        }
+    }
+    fclose(fp);
+
+    CacheHeader header;
+    if (data.size() < sizeof(header)) {
+        this->misses++;
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    size_t expected = sizeof(header) + (size_t) header.packed + (size_t) header.escapes * sizeof(SourceFile::Escape) + (size_t) header.lines * sizeof(uint32_t) + header.strings;
+    if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.format != CACHE_FORMAT ||
+        header.hash != hash || header.size != src.data.size() || data.size() != expected || header.lines == 0 ||
+        hashBytes(0xcbf29ce484222325ull, std::string_view(data).substr(sizeof(header))) != header.checksum) {
+        // stale or damaged, it gets overwritten by the next store
+        this->misses++;
+        return false;
+    }
+
+    const char* p = data.data() + sizeof(header);
+    stream.packed.assign(p, header.packed);
+    stream.replaying = true;
+    p += header.packed;
+    size_t stringsBase = src.strings.size();
+    for (uint32_t e = 0; e < header.escapes; e++, p += sizeof(SourceFile::Escape)) {
+        SourceFile::Escape escape;
+        memcpy(&escape, p, sizeof(escape));
+        escape.start += stringsBase;
+        src.escapes.push_back(escape);
+    }
+    src.lines.resize(header.lines);
+    memcpy(src.lines.data(), p, header.lines * sizeof(uint32_t));
+    p += header.lines * sizeof(uint32_t);
+    src.strings.append(p, header.strings);
+    this->hits++;
+    return true;
+}
+
+void ParseCache::store(SourceTable* sources, uint32_t file, const TokenStream& stream) {
+    SourceFile& src = sources->files[file];
+    CacheHeader header;
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.format = CACHE_FORMAT;
+    header.reserved = 0;
+    header.hash = contentHash(src.data);
+    header.size = src.data.size();
+    header.checksum = 0;
+    header.packed = stream.packed.size();
+    header.escapes = src.escapes.size();
+    header.lines = src.lines.size();
+    header.strings = src.strings.size();
+
+    std::string data;
+    data.reserve(sizeof(header) + header.packed + header.escapes * sizeof(SourceFile::Escape) + header.lines * sizeof(uint32_t) + header.strings);
+    data.append((const char*) &header, sizeof(header));
+    data.append(stream.packed);
+    data.append((const char*) src.escapes.data(), header.escapes * sizeof(SourceFile::Escape));
+    data.append((const char*) src.lines.data(), header.lines * sizeof(uint32_t));
+    data.append(src.strings);
+    header.checksum = hashBytes(0xcbf29ce484222325ull, std::string_view(data).substr(sizeof(header)));
+    memcpy(data.data(), &header, sizeof(header));
+
+    std::error_code ec;
+    std::filesystem::create_directories(this->directory, ec);
+    std::string path = entryPath(this->directory, header.hash);
+    // write next to the entry and rename it into place, readers never see a partial file
+    std::string temp = path + ".tmp." + std::to_string(getpid());
+    FILE* fp = fopen(temp.c_str(), "wb");
+    if (!fp) {
+        LYNX_RT_ERR << "Failed to write parse cache entry " << temp << std::endl;
+        return;
+    }
+    bool written = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    written = fclose(fp) == 0 && written;
+    if (written) {
+        std::filesystem::rename(temp, path, ec);
+    }
+    if (!written || ec) {
+        LYNX_RT_ERR << "Failed to write parse cache entry " << path << std::endl;
+        std::filesystem::remove(temp, ec);
+    }
+}
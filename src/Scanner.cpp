@@ -0,0 +1,210 @@
+#include <LynxConf.hpp>
+
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define LYNX_SCAN_X86
+#endif
+
+// Block scanners used by the tokenizer. Every scanner starts at index i and
+// returns the index of the first byte that does not belong to the run, or size.
+// The SSE2 and AVX2 versions look at 16 or 32 bytes at a time and fall back to
+// the scalar loop for the tail of the buffer.
+
+#define isWhitespace(c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
+#define isIdentifier(c) (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') || ((c) >= '0' && (c) <= '9') || (c) == '_' || (c) == '-')
+#define isNumber(c) (((c) >= '0' && (c) <= '9') || (c) == '.' || (c) == '-' || (c) == '+')
+#define isStringStop(c) ((c) == '"' || (c) == '\\' || (c) == '\0')
+
+#pragma region Scalar
+static size_t scalarWhitespace(const char* data, size_t i, size_t size, std::vector<uint32_t>& lines) {
+    while (i < size && isWhitespace(data[i])) {
+        if (data[i] == '\n') lines.push_back(i + 1);
+        i++;
+    }
+    return i;
+}
+
+static size_t scalarIdentifier(const char* data, size_t i, size_t size) {
+    while (i < size && isIdentifier(data[i])) i++;
+    return i;
+}
+
+static size_t scalarNumber(const char* data, size_t i, size_t size) {
+    while (i < size && isNumber(data[i])) i++;
+    return i;
+}
+
+static size_t scalarString(const char* data, size_t i, size_t size, std::vector<uint32_t>& lines) {
+    while (i < size && !isStringStop(data[i])) {
+        if (data[i] == '\n') lines.push_back(i + 1);
+        i++;
+    }
+    return i;
+}
+#pragma endregion
+
+#ifdef LYNX_SCAN_X86
+static inline void pushLines(uint32_t mask, size_t base, std::vector<uint32_t>& lines) {
+    while (mask) {
+        lines.push_back(base + __builtin_ctz(mask) + 1);
+        mask &= mask - 1;
+    }
+}
+
+#define DEFINE_SCANNERS(_suffix) \
+    TARGET static size_t scanWhitespace##_suffix(const char* data, size_t i, size_t size, std::vector<uint32_t>& lines) { \
+        const V space = splat(' '), tab = splat('\t'), nl = splat('\n'), cr = splat('\r'); \
+        while (i + W <= size) { \
+            V v = load(data + i); \
+            uint32_t newlines = mask(eq(v, nl)); \
+            uint32_t stop = ~mask(vor(vor(eq(v, space), eq(v, tab)), vor(eq(v, nl), eq(v, cr)))) & FULL; \
+            if (stop) { \
+                pushLines(newlines & ((1u << __builtin_ctz(stop)) - 1), i, lines); \
+                return i + __builtin_ctz(stop); \
+            } \
+            pushLines(newlines, i, lines); \
+            i += W; \
+        } \
+        return scalarWhitespace(data, i, size, lines); \
+    } \
+    TARGET static size_t scanIdentifier##_suffix(const char* data, size_t i, size_t size) { \
+        const V a = splat('a' - 1), z = splat('z' + 1), d0 = splat('0' - 1), d9 = splat('9' + 1); \
+        const V lowerBit = splat(0x20), underscore = splat('_'), dash = splat('-'); \
+        while (i + W <= size) { \
+            V v = load(data + i); \
+            V lower = vor(v, lowerBit); \
+            V alpha = vand(gt(lower, a), gt(z, lower)); \
+            V digit = vand(gt(v, d0), gt(d9, v)); \
+            uint32_t stop = ~mask(vor(vor(alpha, digit), vor(eq(v, underscore), eq(v, dash)))) & FULL; \
+            if (stop) { \
+                return i + __builtin_ctz(stop); \
+            } \
+            i += W; \
+        } \
+        return scalarIdentifier(data, i, size); \
+    } \
+    TARGET static size_t scanNumber##_suffix(const char* data, size_t i, size_t size) { \
+        const V d0 = splat('0' - 1), d9 = splat('9' + 1), dot = splat('.'), minus = splat('-'), plus = splat('+'); \
+        while (i + W <= size) { \
+            V v = load(data + i); \
+            V digit = vand(gt(v, d0), gt(d9, v)); \
+            uint32_t stop = ~mask(vor(vor(digit, eq(v, dot)), vor(eq(v, minus), eq(v, plus)))) & FULL; \
+            if (stop) { \
+                return i + __builtin_ctz(stop); \
+            } \
+            i += W; \
+        } \
+        return scalarNumber(data, i, size); \
+    } \
+    TARGET static size_t scanString##_suffix(const char* data, size_t i, size_t size, std::vector<uint32_t>& lines) { \
+        const V quote = splat('"'), backslash = splat('\\'), zero = splat('\0'), nl = splat('\n'); \
+        while (i + W <= size) { \
+            V v = load(data + i); \
+            uint32_t newlines = mask(eq(v, nl)); \
+            uint32_t stop = mask(vor(eq(v, quote), vor(eq(v, backslash), eq(v, zero)))); \
+            if (stop) { \
+                pushLines(newlines & ((1u << __builtin_ctz(stop)) - 1), i, lines); \
+                return i + __builtin_ctz(stop); \
+            } \
+            pushLines(newlines, i, lines); \
+            i += W; \
+        } \
+        return scalarString(data, i, size, lines); \
+    }
+
+#pragma region SSE2
+#define V __m128i
+#define W 16
+#define FULL 0xFFFFu
+#define TARGET
+#define load(_p) _mm_loadu_si128((const __m128i*) (_p))
+#define splat(_c) _mm_set1_epi8(_c)
+#define eq(_a, _b) _mm_cmpeq_epi8(_a, _b)
+#define gt(_a, _b) _mm_cmpgt_epi8(_a, _b)
+#define vor(_a, _b) _mm_or_si128(_a, _b)
+#define vand(_a, _b) _mm_and_si128(_a, _b)
+#define mask(_v) ((uint32_t) _mm_movemask_epi8(_v))
+DEFINE_SCANNERS(SSE2)
+#undef V
+#undef W
+#undef FULL
+#undef TARGET
+#undef load
+#undef splat
+#undef eq
+#undef gt
+#undef vor
+#undef vand
+#undef mask
+#pragma endregion
+
+#pragma region AVX2
+#define V __m256i
+#define W 32
+#define FULL 0xFFFFFFFFu
+#define TARGET __attribute__((target("avx2")))
+#define load(_p) _mm256_loadu_si256((const __m256i*) (_p))
+#define splat(_c) _mm256_set1_epi8(_c)
+#define eq(_a, _b) _mm256_cmpeq_epi8(_a, _b)
+#define gt(_a, _b) _mm256_cmpgt_epi8(_a, _b)
+#define vor(_a, _b) _mm256_or_si256(_a, _b)
+#define vand(_a, _b) _mm256_and_si256(_a, _b)
+#define mask(_v) ((uint32_t) _mm256_movemask_epi8(_v))
+DEFINE_SCANNERS(AVX2)
+#undef V
+#undef W
+#undef FULL
+#undef TARGET
+#undef load
+#undef splat
+#undef eq
+#undef gt
+#undef vor
+#undef vand
+#undef mask
+#pragma endregion
+
+#undef DEFINE_SCANNERS
+#endif
+
+struct Scanner {
+    size_t (*whitespace)(const char*, size_t, size_t, std::vector<uint32_t>&);
+    size_t (*identifier)(const char*, size_t, size_t);
+    size_t (*number)(const char*, size_t, size_t);
+    size_t (*string)(const char*, size_t, size_t, std::vector<uint32_t>&);
+};
+
+static Scanner selectScanner() {
+    if (getenv("LYNX_NO_SIMD")) {
+        return {scalarWhitespace, scalarIdentifier, scalarNumber, scalarString};
+    }
+#ifdef LYNX_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {scanWhitespaceAVX2, scanIdentifierAVX2, scanNumberAVX2, scanStringAVX2};
+    }
+    return {scanWhitespaceSSE2, scanIdentifierSSE2, scanNumberSSE2, scanStringSSE2};
+#else
+    return {scalarWhitespace, scalarIdentifier, scalarNumber, scalarString};
+#endif
+}
+
+static const Scanner scanner = selectScanner();
+
+size_t scanWhitespace(const char* data, size_t i, size_t size, std::vector<uint32_t>& lines) {
+    return scanner.whitespace(data, i, size, lines);
+}
+
+size_t scanIdentifier(const char* data, size_t i, size_t size) {
+    return scanner.identifier(data, i, size);
+}
+
+size_t scanNumber(const char* data, size_t i, size_t size) {
+    return scanner.number(data, i, size);
+}
+
+size_t scanString(const char* data, size_t i, size_t size, std::vector<uint32_t>& lines) {
+    return scanner.string(data, i, size, lines);
+}
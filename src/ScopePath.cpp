@@ -0,0 +1,79 @@
+#include <LynxConf.hpp>
+
+ScopePath::ScopePath(const std::string& path) : path(path) {
+    // empty keys are skipped like getByPath does, except for the last one
+    std::string_view keys(path);
+    size_t start = 0;
+    for (size_t dot = path.find('.'); dot != std::string::npos; dot = path.find('.', start)) {
+        if (dot > start) {
+            this->keys.push_back(keys.substr(start, dot - start));
+        }
+        start = dot + 1;
+    }
+    this->keys.push_back(keys.substr(start));
+}
+
+// Follows the keys from the specified scope, recording the compounds on the way if chain is set.
+static ConfigEntry* lookup(const std::vector<Symbol>& keys, const CompoundEntry* scope, std::vector<ScopePath::Scope>* chain) {
+    const CompoundEntry* current = scope;
+    for (size_t k = 0; k + 1 < keys.size(); k++) {
+        if (chain) {
+            chain->push_back({current, current->version});
+        }
+        current = current->getCompound(keys[k]);
+        if (!current) {
+            return nullptr;
+        }
+    }
+    if (chain) {
+        chain->push_back({current, current->version});
+    }
+    return current->get(keys.back());
+}
+
+ConfigEntry* ScopePath::find(const std::vector<CompoundEntry*>& compoundStack) {
+    size_t size = compoundStack.size();
+    for (size_t depth = 0; depth < size; depth++) {
+        const CompoundEntry* scope = compoundStack[size - 1 - depth];
+        if (depth < this->misses.size()) {
+            const Scope& miss = this->misses[depth];
+            if (miss.compound == scope && miss.version == scope->version) {
+                // unchanged since it was searched, the path is still not there
+                continue;
+            }
+        } else if (this->entry && this->chain[0].compound == scope) {
+            bool changed = false;
+            for (const Scope& link : this->chain) {
+                if (link.version != link.compound->version) {
+                    changed = true;
+                    break;
+                }
+            }
+            if (!changed) {
+                return this->entry;
+            }
+        }
+        // the chain of the cached entry is only needed until the lookup gets to its depth
+        bool record = depth == this->misses.size();
+        if (record) {
+            this->chain.clear();
+        }
+        ConfigEntry* found = lookup(this->keys, scope, record ? &this->chain : nullptr);
+        if (found) {
+            if (!record) {
+                this->misses.resize(depth);
+                this->chain.clear();
+                lookup(this->keys, scope, &this->chain);
+            }
+            this->entry = found;
+            return found;
+        }
+        if (depth < this->misses.size()) {
+            this->misses[depth] = {scope, scope->version};
+        } else {
+            this->misses.push_back({scope, scope->version});
+            this->entry = nullptr;
+        }
+    }
+    return nullptr;
+}
@@ -4,12 +4,16 @@ StringEntry::StringEntry() {
     this->setType(EntryType::String);
 }
 
-std::string StringEntry::getValue() const {
+const std::string& StringEntry::getValue() const {
     return this->value;
 }
 
 void StringEntry::setValue(std::string value) {
-    this->value = value;
+    this->value = std::move(value);
+}
+
+void StringEntry::append(std::string_view value) {
+    this->value.append(value);
 }
 
 bool StringEntry::isEmpty() const {
@@ -38,7 +42,8 @@ void StringEntry::print(std::ostream& stream, int indent) const {
 
 ConfigEntry* StringEntry::clone() {
     StringEntry* entry = new StringEntry();
-    entry->setKey(this->getKey());
+    entry->setKey(this->getSymbol());
+    ConfigEntry::clones++;
     entry->setValue(this->value);
     return ((ConfigEntry*) entry);
 }
@@ -0,0 +1,64 @@
+#include <mutex>
+#include <atomic>
+#include <cstdlib>
+#include <unordered_map>
+
+#include <LynxConf.hpp>
+
+// Names are kept in blocks that never move, so name() can read them without taking the lock while other threads
+// intern new ones.
+struct SymbolTable {
+    static constexpr size_t blockSize = 1024;
+    static constexpr size_t maxBlocks = 16384;
+
+    std::mutex mutex;
+    // the views point into the blocks
+    std::unordered_map<std::string_view, uint32_t> ids;
+    std::atomic<std::string*> blocks[maxBlocks] = {};
+    uint32_t count = 0;
+
+    SymbolTable() {
+        this->add("");
+    }
+
+    uint32_t add(std::string_view name) {
+        size_t block = this->count / blockSize;
+        if (block >= maxBlocks) {
+            LYNX_RT_ERR << "Too many symbols" << std::endl;
+            std::abort();
+        }
+        std::string* names = this->blocks[block].load(std::memory_order_relaxed);
+        if (!names) {
+            names = new std::string[blockSize];
+            this->blocks[block].store(names, std::memory_order_release);
+        }
+        std::string& stored = names[this->count % blockSize];
+        stored = name;
+        this->ids.emplace(stored, this->count);
+        return this->count++;
+    }
+};
+
+static SymbolTable& symbols() {
+    static SymbolTable table;
+    return table;
+}
+
+Symbol::Symbol(std::string_view name) {
+    if (name.empty()) {
+        return;
+    }
+    SymbolTable& table = symbols();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto found = table.ids.find(name);
+    this->id = found != table.ids.end() ? found->second : table.add(name);
+}
+
+const std::string& Symbol::name() const {
+    SymbolTable& table = symbols();
+    return table.blocks[this->id / SymbolTable::blockSize].load(std::memory_order_acquire)[this->id % SymbolTable::blockSize];
+}
+
+std::ostream& operator<<(std::ostream& out, Symbol symbol) {
+    return out << symbol.name();
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+
+#include <LynxConf.hpp>
+
+#pragma region ThunkEntry
+ThunkEntry::ThunkEntry(ConfigParser* parser, TokenList tokens, const std::vector<CompoundEntry*>& compoundStack) : parser(parser), tokens(tokens), compoundStack(compoundStack) {
+    this->setType(EntryType::Thunk);
+}
+
+ConfigEntry* ThunkEntry::force() {
+    if (this->value || this->failed) {
+        return this->value;
+    }
+    if (this->evaluating) {
+        LYNX_RT_ERR << "The value of '" << this->getKey() << "' depends on itself" << std::endl;
+        return nullptr;
+    }
+    // values are also evaluated after the parse returned, their entries still belong to the parser
+    Arena* previous = Arena::current;
+    Arena::current = &this->parser->arena;
+    this->evaluating = true;
+    this->parser->declaring.push_back(this->getSymbol());
+    int i = 0;
+    this->parser->member = this->tokens[0].type == Token::CompoundStart;
+    ConfigEntry* entry = this->parser->parseValue(this->tokens, i, this->compoundStack);
+    this->parser->declaring.pop_back();
+    this->evaluating = false;
+    if (entry && entry->getType() == EntryType::Compound) {
+        for (const CompoundEntry* scope : this->compoundStack) {
+            if (((CompoundEntry*) entry)->shares(scope)) {
+                // a function that returned the compound the value is declared in, which did not exist yet
+                LYNX_ERR << "The value of '" << this->getKey() << "' contains itself" << std::endl;
+                entry = nullptr;
+                break;
+            }
+        }
+    }
+    if (entry) {
+        entry->setKey(this->getSymbol());
+        if (this->type && !this->type->validate(entry, {}, std::cerr)) {
+            LYNX_ERR << "Invalid entry type for key '" << this->getKey() << "'" << std::endl;
+            entry = nullptr;
+        }
+    }
+    Arena::current = previous;
+    if (!entry) {
+        LYNX_ERR << "Failed to parse value for key '" << this->getKey() << "'" << std::endl;
+        this->failed = true;
+        this->parser->failures++;
+        return nullptr;
+    }
+    this->value = entry;
+    return entry;
+}
+
+bool ThunkEntry::isDone() const {
+    return this->value || this->failed;
+}
+
+bool ThunkEntry::sees(const CompoundEntry* scope) const {
+    return std::find(this->compoundStack.begin(), this->compoundStack.end(), scope) != this->compoundStack.end();
+}
+
+ConfigEntry* ThunkEntry::clone() {
+    ConfigEntry* entry = this->force();
+    return entry ? entry->clone() : nullptr;
+}
+
+bool ThunkEntry::operator==(const ConfigEntry& other) {
+    ConfigEntry* entry = this->force();
+    return entry && entry->operator==(other);
+}
+
+bool ThunkEntry::operator!=(const ConfigEntry& other) {
+    return !operator==(other);
+}
+
+void ThunkEntry::print(std::ostream& stream, int indent) const {
+    // a value that failed to evaluate has already been reported
+    if (this->value) {
+        this->value->print(stream, indent);
+    }
+}
+#pragma endregion
+
+#pragma region Deferring
+// Returns the index of the last token of the value starting at the specified token, or -1 if it cannot be found
+// without evaluating something. Calls are only skipped if the function they call is already known, a deferred
+// value that would have to be evaluated to know how many arguments it takes is not.
+static int valueEnd(TokenList& tokens, int i, const std::vector<CompoundEntry*>& compoundStack) {
+    if (!tokens.has(i)) {
+        return -1;
+    }
+    switch (tokens[i].type) {
+        case Token::String:
+        case Token::Number:
+            return i;
+        case Token::BlockStart: {
+            int end = (int) tokens.blockEnd(i);
+            return tokens[end].type == Token::BlockEnd && end > i ? end : -1;
+        }
+        case Token::ListStart:
+        case Token::CompoundStart: {
+            auto open = tokens[i].type;
+            auto close = open == Token::ListStart ? Token::ListEnd : Token::CompoundEnd;
+            int depth = 1;
+            int end = i + 1;
+            for (; tokens.has(end); end++) {
+                if (tokens[end].type == open) {
+                    depth++;
+                } else if (tokens[end].type == close && --depth == 0) {
+                    return end;
+                }
+            }
+            return -1;
+        }
+        case Token::Identifier: {
+            Symbol name = tokens[i].symbol;
+            if (findBuiltin(name) || (tokens.has(i + 1) && tokens[i + 1].type == Token::Dot)) {
+                return -1;
+            }
+            FunctionEntry* function = findNative(name);
+            if (!function) {
+                ConfigEntry* entry = nullptr;
+                for (size_t s = compoundStack.size(); s > 0 && !entry; s--) {
+                    entry = compoundStack[s - 1]->peek(name);
+                }
+                if (!entry || entry->getType() == EntryType::Thunk) {
+                    return -1;
+                }
+                if (entry->getType() != EntryType::Function) {
+                    return i;
+                }
+                function = (FunctionEntry*) entry;
+            }
+            int end = i;
+            for (size_t n = 0; n < function->args.size(); n++) {
+                end++;
+                if (tokens.has(end) && tokens[end].type == Token::Assign) {
+                    end += 2;
+                }
+                end = valueEnd(tokens, end, compoundStack);
+                if (end < 0) {
+                    return -1;
+                }
+            }
+            return end;
+        }
+        default:
+            return -1;
+    }
+}
+
+// Checks that evaluating the tokens later gives the same value and leaves the other values the same. Values that
+// change or look at the scopes, exit, or change files that other values may read are evaluated right away, and so
+// are values that mention a member that is being declared.
+static bool deferrable(TokenList& tokens, int from, int to, const std::vector<Symbol>& declaring) {
+    static const Symbol eager[] = {
+        Symbol("set"), Symbol("use"), Symbol("exists"), Symbol("exit"), Symbol("file-mkdir"), Symbol("file-rmdir"),
+        Symbol("file-remove"), Symbol("file-write"), Symbol("file-copy")
+    };
+    for (int k = from; k <= to; k++) {
+        const Token& token = tokens[k];
+        if (token.type == Token::Identifier) {
+            if (std::find(std::begin(eager), std::end(eager), token.symbol) != std::end(eager)) {
+                return false;
+            }
+            bool head = k == from || tokens[k - 1].type != Token::Dot;
+            if (head && std::find(declaring.begin(), declaring.end(), token.symbol) != declaring.end()) {
+                return false;
+            }
+        } else if (token.type == Token::Dot && (k == from || tokens[k - 1].type != Token::Identifier)) {
+            // the compound being declared, which is only complete later
+            return false;
+        }
+    }
+    return true;
+}
+
+ThunkEntry* ConfigParser::defer(TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
+    if (!tokens.has(i) || tokens[i].type == Token::String || tokens[i].type == Token::Number) {
+        // literals cost less to evaluate than to defer
+        return nullptr;
+    }
+    int end = valueEnd(tokens, i, compoundStack);
+    if (end < 0 || !deferrable(tokens, i, end, this->declaring)) {
+        return nullptr;
+    }
+    ThunkEntry* thunk = new ThunkEntry(this, tokens.slice(i, end + 1), compoundStack);
+    i = end;
+    // the thunk keeps the stack like a function does
+    this->captures++;
+    this->pending.push_back(thunk);
+    return thunk;
+}
+
+bool ConfigParser::forcePending(const CompoundEntry* scope) {
+    bool forced = true;
+    while (forced) {
+        forced = false;
+        // the values declared while these are evaluated end up in pending again, after the ones that are kept
+        std::vector<ThunkEntry*> thunks;
+        thunks.swap(this->pending);
+        std::vector<ThunkEntry*> kept;
+        for (size_t n = 0; n < thunks.size(); n++) {
+            ThunkEntry* thunk = thunks[n];
+            if (thunk->isDone()) {
+                continue;
+            }
+            if (thunk->evaluating || (scope && !thunk->sees(scope))) {
+                // the ones being evaluated finish on their own, the others cannot see the names of the scope
+                kept.push_back(thunk);
+                continue;
+            }
+            forced = true;
+            if (!thunk->force()) {
+                kept.insert(kept.end(), thunks.begin() + n + 1, thunks.end());
+                this->pending.insert(this->pending.begin(), kept.begin(), kept.end());
+                return false;
+            }
+        }
+        this->pending.insert(this->pending.begin(), kept.begin(), kept.end());
+    }
+    return true;
+}
+#pragma endregion
@@ -1,5 +1,19 @@
 #include <LynxConf.hpp>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 bool isValidIdentifier(char c) {
     return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
 }
@@ -8,109 +22,664 @@ static bool isnumber(char c) {
     return (c >= '0' && c <= '9');
 }
 
-#define skipWhitespace() while (i < data.size() && (data[i] == ' ' || data[i] == '\t' || data[i] == '\n' || data[i] == '\r')) { if (data[i] == '\n') {line++; column = 0;} else column++; i++;  }
-#define next(_r) ({ i++; column++; if (i >= data.size()) { LYNX_ERR << "Unexpected end of file" << std::endl; return _r; } data[i]; })
-#define maybeNext(_r) ({ i++; column++; i < data.size() ? data[i] : '\0'; })
-#define prev(_r) ({ i--; if (i < 0) { LYNX_ERR << "Unexpected start of file" << std::endl; return _r; } data[i]; })
-#define nextChar(_r) ({ i++; column++; skipWhitespace(); if (i >= data.size()) { LYNX_ERR << "Unexpected end of file" << std::endl; return _r; } data[i]; })
-#define peek() ({ skipWhitespace(); data[i]; })
+static bool isNumberChar(char c) {
+    return isnumber(c) || c == '.' || c == '-' || c == '+';
+}
+
+size_t scanWhitespace(const char* data, size_t i, size_t size, std::vector<uint32_t>& lines);
+size_t scanIdentifier(const char* data, size_t i, size_t size);
+size_t scanNumber(const char* data, size_t i, size_t size);
+size_t scanString(const char* data, size_t i, size_t size, std::vector<uint32_t>& lines);
+
+// Most runs are short, so the first few bytes are checked inline before handing off to the block scanners.
+#define SHORT_RUN 8
+#define run(_scan, _test, ...) ({ \
+    size_t _j = i; \
+    while (_j < data.size() && _j < i + SHORT_RUN && _test(data[_j])) { __VA_ARGS__; _j++; } \
+    _j == i + SHORT_RUN ? _scan : _j; \
+})
+
+#define LEX_ERR LYNX_RT_ERR_TO(err) << src.locate(i) << ": "
+
+// A '--' comment can start in the middle of an identifier or number run, end the token before it.
+#define cutComment() for (int64_t _k = token.offset; _k + 1 < i; _k++) if (data[_k] == '-' && data[_k + 1] == '-') { i = _k; break; }
+
+#define isWhitespace(c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
+#define skipWhitespace() i = run(scanWhitespace(data.data(), _j, data.size(), src.lines), isWhitespace, if (data[_j] == '\n') src.lines.push_back(_j + 1))
+#define next(_r) ({ i++; if (i >= data.size()) { LEX_ERR << "Unexpected end of file" << std::endl; return _r; } data[i]; })
+#define prev(_r) ({ i--; if (i < 0) { LEX_ERR << "Unexpected start of file" << std::endl; return _r; } data[i]; })
+#define peek() ({ skipWhitespace(); i < data.size() ? data[i] : '\0'; })
 
 bool Token::operator==(const Token& other) const {
-    return this->type == other.type && this->value == other.value;
+    return this->type == other.type && this->file == other.file && this->offset == other.offset && this->length == other.length;
 }
 
 bool Token::operator!=(const Token& other) const {
     return !operator==(other);
 }
 
-std::vector<Token> tokenize(std::string file, std::string& data, int& i) {
-    std::vector<Token> tokens;
-    int line = 1;
-    int column = 0;
+std::ostream& operator<<(std::ostream& out, const SourceLocation& location) {
+    if (location.file) {
+        out << *location.file;
+    }
+    return out << ":" << location.line << ":" << (location.column + 1);
+}
+
+#pragma region SourceFile
+SourceLocation SourceFile::locate(uint32_t offset) const {
+    if (this->lines.empty()) {
+        return {&this->path, 1, offset};
+    }
+    auto it = std::upper_bound(this->lines.begin(), this->lines.end(), offset);
+    size_t line = it - this->lines.begin();
+    return {&this->path, (uint32_t) line, offset - this->lines[line - 1]};
+}
+
+SourceFile::~SourceFile() {
+#ifndef _WIN32
+    if (this->mapping) {
+        munmap(this->mapping, this->mappingSize);
+    }
+#endif
+}
+
+uint32_t SourceTable::add(const std::string& path, std::string data) {
+    SourceFile& file = this->files.emplace_back();
+    file.path = path;
+    file.buffer = std::move(data);
+    file.data = file.buffer;
+    file.lines.push_back(0);
+    return this->files.size() - 1;
+}
+
+int64_t SourceTable::load(const std::string& path) {
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            close(fd);
+            madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+            SourceFile& file = this->files.emplace_back();
+            file.path = path;
+            file.mapping = mapping;
+            file.mappingSize = st.st_size;
+            file.data = std::string_view((const char*) mapping, st.st_size);
+            file.lines.push_back(0);
+            return this->files.size() - 1;
+        }
+    }
+    close(fd);
+#endif
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return -1;
+    }
+    std::string data;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        data.append(buf, n);
+    }
+    fclose(fp);
+    return this->add(path, std::move(data));
+}
+
+std::string_view SourceTable::text(const Token& token) const {
+    const SourceFile& src = this->files[token.file];
+    if (token.type != Token::String) {
+        return src.data.substr(token.offset, token.length);
+    }
+    if (token.length < 2) {
+        return {};
+    }
+    if (token.flags & Token::Decoded) {
+        auto it = std::lower_bound(src.escapes.begin(), src.escapes.end(), token.offset, [](const SourceFile::Escape& e, uint32_t offset) {
+            return e.offset < offset;
+        });
+        return std::string_view(src.strings).substr(it->start, it->length);
+    }
+    return src.data.substr(token.offset + 1, token.length - 2);
+}
+
+SourceLocation SourceTable::location(const Token& token) const {
+    return this->files[token.file].locate(token.offset);
+}
+#pragma endregion
+
+#pragma region TokenStream
+static int lexToken(SourceFile& src, uint32_t file, int64_t& i, Token& token, std::ostream& err);
+
+static const Token invalidToken = {Token::Invalid, 0, 0, 0, 0};
+
+// Packed tokens are a type byte with the Decoded flag in the high bit, then the distance
+// from the previous token and the length as varints. Most tokens take three or four bytes.
+static void packVarint(std::string& out, uint32_t value) {
+    while (value >= 0x80) {
+        out += (char) (value | 0x80);
+        value >>= 7;
+    }
+    out += (char) value;
+}
+
+static void packToken(std::string& out, uint32_t previous, const Token& token) {
+    out += (char) (token.type | (token.flags & Token::Decoded ? 0x80 : 0));
+    packVarint(out, token.offset - previous);
+    packVarint(out, token.length);
+}
+
+static uint32_t unpackVarint(const std::string& in, size_t& position) {
+    uint32_t value = 0;
+    for (int shift = 0; position < in.size() && shift < 35; shift += 7) {
+        uint8_t byte = in[position++];
+        value |= (uint32_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return value;
+}
+
+TokenStream::TokenStream(SourceTable* sources, uint32_t file) {
+    this->sources = sources;
+    this->file = file;
+}
+
+bool TokenStream::fill(size_t index) {
+    while (this->base + this->window.size() <= index) {
+        if (this->done) {
+            return false;
+        }
+        Token token = {Token::CompoundStart, 0, this->file, 0, 0};
+        if (this->started) {
+            int result;
+            if (this->replaying) {
+                result = this->packedPosition < this->packed.size();
+                if (result) {
+                    uint8_t type = this->packed[this->packedPosition++];
+                    token.type = (decltype(token.type)) (type & 0x7F);
+                    token.flags = type & 0x80 ? Token::Decoded : 0;
+                    token.offset = this->packedOffset + unpackVarint(this->packed, this->packedPosition);
+                    token.length = unpackVarint(this->packed, this->packedPosition);
+                }
+            } else {
+                result = lexToken(this->sources->files[this->file], this->file, this->position, token, std::cerr);
+                if (result > 0 && this->recording) {
+                    packToken(this->packed, this->packedOffset, token);
+                }
+            }
+            if (result > 0) {
+                this->packedOffset = token.offset;
+            }
+            if (result <= 0) {
+                // close the root compound, the parser reports a missing '}' if lexing failed
+                this->done = true;
+                this->failed = result < 0;
+                if (this->failed) {
+                    return false;
+                }
+                token = {Token::CompoundEnd, 0, this->file, (uint32_t) this->sources->files[this->file].data.size(), 0};
+            }
+        }
+        this->started = true;
+        if (token.type == Token::Identifier) {
+            token.symbol = Symbol(this->sources->text(token));
+        }
+        this->window.push_back(token);
+    }
+    if (index > this->highest) {
+        this->highest = index;
+    }
+    // drop what nobody can reach anymore
+    size_t keep = this->highest > Lookbehind ? this->highest - Lookbehind : 0;
+    for (size_t pin : this->pins) {
+        keep = std::min(keep, pin);
+    }
+    while (this->base < keep && !this->window.empty()) {
+        this->window.pop_front();
+        this->base++;
+    }
+    return true;
+}
+
+const Token& TokenStream::at(size_t index) {
+    if (index < this->base || !this->fill(index)) {
+        return invalidToken;
+    }
+    return this->window[index - this->base];
+}
+#pragma endregion
+
+#pragma region TokenList
+TokenList::TokenList(SourceTable* sources) {
+    this->storage = std::make_shared<TokenStorage>();
+    this->begin = 0;
+    this->end = 0;
+    this->sources = sources;
+}
+
+TokenList::TokenList(std::shared_ptr<TokenStream> stream) {
+    this->stream = stream;
+    this->begin = 0;
+    this->end = 0;
+    this->sources = stream->sources;
+}
+
+bool TokenList::has(size_t index) const {
+    if (this->stream) {
+        return this->stream->fill(index);
+    }
+    return index < this->size();
+}
+
+size_t TokenList::size() const {
+    if (this->stream) {
+        size_t i = this->stream->base + this->stream->window.size();
+        while (this->stream->fill(i)) i++;
+        return i;
+    }
+    return this->end - this->begin;
+}
+
+bool TokenList::empty() const {
+    if (this->stream) {
+        return !this->has(0);
+    }
+    return this->end == this->begin;
+}
+
+const Token& TokenList::operator[](size_t index) const {
+    if (this->stream) {
+        return this->stream->at(index);
+    }
+    return this->storage->tokens[this->begin + index];
+}
+
+void TokenList::push_back(const Token& token) {
+    if (this->stream) {
+        LYNX_RT_ERR << "Cannot append to a token stream" << std::endl;
+        return;
+    }
+    if (this->end != this->storage->tokens.size()) {
+        // this is a slice of a shared list, detach before growing it
+        std::shared_ptr<TokenStorage> storage = std::make_shared<TokenStorage>();
+        storage->tokens.assign(this->storage->tokens.begin() + this->begin, this->storage->tokens.begin() + this->end);
+        this->storage = storage;
+        this->begin = 0;
+        this->end = this->storage->tokens.size();
+    }
+    this->storage->tokens.push_back(token);
+    this->end++;
+}
+
+TokenList TokenList::slice(size_t from, size_t to) const {
+    if (this->stream) {
+        // copy the captured tokens out of the window, the stream moves on without them
+        TokenList list(this->sources);
+        for (size_t i = from; i < to && this->has(i); i++) {
+            list.push_back(this->stream->at(i));
+        }
+        return list;
+    }
+    TokenList list = *this;
+    list.begin = this->begin + std::min(from, this->size());
+    list.end = this->begin + std::min(to, this->size());
+    return list;
+}
+
+void TokenList::pin(size_t index) const {
+    if (this->stream) {
+        this->stream->pins.push_back(index);
+    }
+}
+
+void TokenList::unpin() const {
+    if (this->stream && !this->stream->pins.empty()) {
+        this->stream->pins.pop_back();
+    }
+}
+
+std::string_view TokenList::value(size_t index) const {
+    if (!this->has(index)) {
+        return {};
+    }
+    return this->sources->text((*this)[index]);
+}
+
+SourceLocation TokenList::location(size_t index) const {
+    if (this->stream) {
+        TokenStream& stream = *this->stream;
+        if (!stream.fill(index) && stream.window.empty()) {
+            return {nullptr, 0, 0};
+        }
+        const Token& token = index < stream.base ? stream.window.front() : stream.window[std::min(index - stream.base, stream.window.size() - 1)];
+        return this->sources->location(token);
+    }
+    if (this->empty()) {
+        return {nullptr, 0, 0};
+    }
+    return this->sources->location((*this)[std::min(index, this->size() - 1)]);
+}
+
+std::unique_ptr<Node>* TokenList::node(size_t index) const {
+    if (this->stream) {
+        return nullptr;
+    }
+    std::vector<std::unique_ptr<Node>>& nodes = this->storage->nodes;
+    if (nodes.size() <= this->begin + index) {
+        nodes.resize(this->storage->tokens.size());
+    }
+    return &nodes[this->begin + index];
+}
+
+size_t TokenList::blockEnd(size_t index) const {
+    if (!this->stream) {
+        std::vector<uint32_t>& ends = this->storage->blockEnds;
+        size_t at = this->begin + index;
+        // a remembered end is only valid if this slice reaches it
+        if (at < ends.size() && ends[at] && ends[at] < this->end) {
+            return ends[at] - this->begin;
+        }
+    }
+    size_t i = index + 1;
+    int blockDepth = 1;
+    while (this->has(i) && blockDepth > 0) {
+        if ((*this)[i].type == Token::BlockStart) {
+            blockDepth++;
+        } else if ((*this)[i].type == Token::BlockEnd) {
+            blockDepth--;
+        }
+        i++;
+    }
+    i--;
+    if (!this->stream && blockDepth == 0) {
+        std::vector<uint32_t>& ends = this->storage->blockEnds;
+        if (ends.size() <= this->begin + index) {
+            ends.resize(this->storage->tokens.size());
+        }
+        ends[this->begin + index] = this->begin + i;
+    }
+    return i;
+}
+
+bool TokenList::operator==(const TokenList& other) const {
+    if (this->size() != other.size()) return false;
+    for (size_t i = 0; i < this->size(); i++) {
+        if ((*this)[i] != other[i]) return false;
+    }
+    return true;
+}
+
+bool TokenList::operator!=(const TokenList& other) const {
+    return !operator==(other);
+}
+#pragma endregion
+
+// Lexes the next token starting at i and leaves i after it.
+// Returns 1 if a token was read, 0 at the end of the file and -1 on errors.
+static int lexToken(SourceFile& src, uint32_t file, int64_t& i, Token& token, std::ostream& err) {
+    std::string_view data = src.data;
     char c = peek();
     while (c != '\0') {
-        Token token;
+        token.flags = 0;
         token.file = file;
-        token.line = line;
-        token.column = column;
+        token.offset = i;
         if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
             skipWhitespace();
             c = peek();
             continue;
+        } else if (c == '-' && i + 1 < data.size() && data[i + 1] == '-') {
+            const void* newline = memchr(data.data() + i, '\n', data.size() - i);
+            i = newline ? (const char*) newline - data.data() : data.size();
+            c = peek();
+            continue;
         } else if (c == '"') {
             token.type = Token::String;
-            token.value = "";
-            c = next({});
-            while (c != '"' && c != '\0') {
-                if (c == '\\') {
-                    c = next({});
-                    switch (c) {
-                        case 'n': token.value += '\n'; break;
-                        case 'r': token.value += '\r'; break;
-                        case 't': token.value += '\t'; break;
-                        case '0': token.value += '\0'; break;
-                        case '\\': token.value += '\\'; break;
-                        case '"': token.value += '"'; break;
-                        default: LYNX_ERR << "Invalid escape sequence: \\" << c << std::endl; return tokens;
-                    }
-                } else {
-                    token.value += c;
+            next(-1);
+            while (true) {
+                size_t end = scanString(data.data(), i, data.size(), src.lines);
+                if (token.flags & Token::Decoded) {
+                    src.strings.append(data.substr(i, end - i));
+                }
+                i = end;
+                if (i >= data.size()) {
+                    LEX_ERR << "Unexpected end of file" << std::endl;
+                    return -1;
+                }
+                if (data[i] == '\0') {
+                    LEX_ERR << "Unexpected end of file" << std::endl;
+                    return -1;
+                }
+                if (data[i] == '"') {
+                    break;
                 }
-                c = next({});
+                if (!(token.flags & Token::Decoded)) {
+                    // first escape: move what we have so far into the decoded string table
+                    token.flags |= Token::Decoded;
+                    src.escapes.push_back({token.offset, (uint32_t) src.strings.size(), 0});
+                    src.strings.append(data.substr(token.offset + 1, i - token.offset - 1));
+                }
+                c = next(-1);
+                switch (c) {
+                    case 'n': src.strings += '\n'; break;
+                    case 'r': src.strings += '\r'; break;
+                    case 't': src.strings += '\t'; break;
+                    case '0': src.strings += '\0'; break;
+                    case '\\': src.strings += '\\'; break;
+                    case '"': src.strings += '"'; break;
+                    default: LEX_ERR << "Invalid escape sequence: \\" << c << std::endl; return -1;
+                }
+                next(-1);
             }
-            if (c == '\0') {
-                LYNX_ERR << "Unexpected end of file" << std::endl;
-                return tokens;
+            if (token.flags & Token::Decoded) {
+                src.escapes.back().length = src.strings.size() - src.escapes.back().start;
             }
         } else if (isnumber(c) || c == '-' || c == '+') {
             token.type = Token::Number;
-            token.value = "";
-            while (isnumber(c) || c == '.' || c == '-' || c == '+') {
-                token.value += c;
-                c = next({});
+            i = run(scanNumber(data.data(), _j, data.size()), isNumberChar);
+            cutComment();
+            if (i >= data.size()) {
+                LEX_ERR << "Unexpected end of file" << std::endl;
+                return -1;
             }
-            prev({});
+            prev(-1);
         } else if (c == '[') {
             token.type = Token::ListStart;
-            token.value = "[";
         } else if (c == ']') {
             token.type = Token::ListEnd;
-            token.value = "]";
         } else if (c == '{') {
             token.type = Token::CompoundStart;
-            token.value = "{";
         } else if (c == '}') {
             token.type = Token::CompoundEnd;
-            token.value = "}";
         } else if (c == '(') {
             token.type = Token::BlockStart;
-            token.value = "(";
         } else if (c == ')') {
             token.type = Token::BlockEnd;
-            token.value = ")";
         } else if (c == '.') {
             token.type = Token::Dot;
-            token.value = ".";
         } else if (c == '=') {
             token.type = Token::Assign;
-            token.value = "=";
         } else if (c == ':') {
             token.type = Token::Is;
-            token.value = ":";
         } else if (isValidIdentifier(c)) {
             token.type = Token::Identifier;
-            token.value = "";
-            while (isValidIdentifier(c)) {
-                token.value += c;
-                c = next({});
+            i = run(scanIdentifier(data.data(), _j, data.size()), isValidIdentifier);
+            cutComment();
+            if (i >= data.size()) {
+                LEX_ERR << "Unexpected end of file" << std::endl;
+                return -1;
             }
-            prev({});
+            prev(-1);
         } else {
-            LYNX_ERR << "Invalid character: " << c << std::endl;
-            return tokens;
+            LEX_ERR << "Invalid character: " << c << std::endl;
+            return -1;
+        }
+        token.length = i + 1 - token.offset;
+        i++;
+        return 1;
+    }
+    return 0;
+}
+
+#pragma region Parallel
+// Large files are cut into chunks at newlines and every chunk is lexed on its own,
+// assuming it starts between two tokens. That guess is wrong when the cut lands in
+// a multi-line string, so the chunks are stitched together at a token offset: the
+// lexer only carries its position from one token to the next, so once two runs
+// produce a token at the same offset they agree on everything after it.
+
+#define CHUNK_SIZE (4 << 20)
+
+struct LexChunk {
+    int64_t start;
+    int64_t stop;
+    // offset of the first token at or after stop, or the end of the file
+    int64_t end = 0;
+    int result = 0;
+    // tokens packed like TokenStream::packed, the first one relative to offset 0
+    std::string packed;
+    uint32_t last = 0;
+    // lines, escapes and decoded strings found in this chunk
+    SourceFile scratch;
+};
+
+static void lexChunk(const SourceFile& src, uint32_t file, LexChunk& chunk) {
+    // a wrong guess produces bogus errors, keep them quiet
+    std::ostream quiet(nullptr);
+    chunk.scratch.path = src.path;
+    chunk.scratch.data = src.data;
+    int64_t i = chunk.start;
+    Token token;
+    while ((chunk.result = lexToken(chunk.scratch, file, i, token, quiet)) > 0) {
+        if (token.offset >= chunk.stop) {
+            break;
         }
-        tokens.push_back(token);
-        c = maybeNext({});
+        packToken(chunk.packed, chunk.last, token);
+        chunk.last = token.offset;
+    }
+    chunk.end = chunk.result > 0 ? token.offset : src.data.size();
+}
+
+unsigned tokenizeThreads(size_t size) {
+    unsigned threads = std::thread::hardware_concurrency();
+    if (const char* env = getenv("LYNX_THREADS")) {
+        threads = atoi(env);
     }
-    return tokens;
+    threads = std::min<size_t>(threads, size / CHUNK_SIZE);
+    return std::max(threads, 1u);
+}
+
+bool tokenize(SourceTable* sources, uint32_t file, TokenStream& stream) {
+    SourceFile& src = sources->files[file];
+    std::string_view data = src.data;
+    unsigned threads = tokenizeThreads(data.size());
+    size_t count = std::max<size_t>(threads * 4, data.size() / CHUNK_SIZE);
+
+    std::vector<int64_t> starts(count + 1);
+    for (size_t k = 1; k < count; k++) {
+        size_t start = std::max<size_t>(data.size() * k / count, starts[k - 1]);
+        size_t newline = data.find('\n', start);
+        starts[k] = newline == std::string_view::npos ? data.size() : newline + 1;
+    }
+    // the last chunk never stops early
+    starts[count] = data.size() + 1;
+
+    std::vector<std::unique_ptr<LexChunk>> chunks(count);
+    for (size_t k = 0; k < count; k++) {
+        chunks[k] = std::make_unique<LexChunk>();
+        chunks[k]->start = starts[k];
+        chunks[k]->stop = starts[k + 1];
+    }
+    std::atomic<size_t> nextChunk = 0;
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([&]() {
+            for (size_t k; (k = nextChunk++) < count;) {
+                lexChunk(src, file, *chunks[k]);
+            }
+        });
+    }
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+
+    size_t packedSize = 0, lineCount = 0;
+    for (auto& chunk : chunks) {
+        packedSize += chunk->packed.size();
+        lineCount += chunk->scratch.lines.size();
+    }
+    stream.packed.reserve(packedSize);
+    src.lines.reserve(lineCount + 1);
+
+    // stitch the chunks together, q is the offset of the next token
+    int64_t q = 0;
+    size_t m = 0;
+    uint32_t previous = 0;
+    while (true) {
+        while (m + 1 < count && starts[m + 1] <= q) m++;
+        // find the first token to take, any token of a chunk that starts at q will do
+        size_t position = 0;
+        uint32_t offset = 0;
+        while (position < chunks[m]->packed.size()) {
+            size_t next = position + 1;
+            offset += unpackVarint(chunks[m]->packed, next);
+            if (offset >= q) break;
+            unpackVarint(chunks[m]->packed, next);
+            position = next;
+        }
+        if (chunks[m]->start != q && (position == chunks[m]->packed.size() || offset != q)) {
+            // the guess was wrong, lex the chunk again from where the previous one ended
+            chunks[m] = std::make_unique<LexChunk>();
+            chunks[m]->start = q;
+            chunks[m]->stop = starts[m + 1];
+            lexChunk(src, file, *chunks[m]);
+            position = 0;
+            offset = 0;
+            if (!chunks[m]->packed.empty()) {
+                size_t next = 1;
+                offset = unpackVarint(chunks[m]->packed, next);
+            }
+        }
+        LexChunk& chunk = *chunks[m];
+        if (chunk.result < 0) {
+            break;
+        }
+        if (position < chunk.packed.size()) {
+            // only the first token is relative to something outside the chunk
+            size_t next = position + 1;
+            unpackVarint(chunk.packed, next);
+            stream.packed += chunk.packed[position];
+            packVarint(stream.packed, offset - previous);
+            stream.packed.append(chunk.packed, next);
+            previous = chunk.last;
+        }
+        std::vector<uint32_t>& lines = chunk.scratch.lines;
+        src.lines.insert(src.lines.end(), std::upper_bound(lines.begin(), lines.end(), q), std::upper_bound(lines.begin(), lines.end(), chunk.end));
+        for (const SourceFile::Escape& escape : chunk.scratch.escapes) {
+            if (escape.offset >= q && escape.offset < chunk.end) {
+                src.escapes.push_back({escape.offset, (uint32_t) src.strings.size(), escape.length});
+                src.strings.append(chunk.scratch.strings, escape.start, escape.length);
+            }
+        }
+        q = chunk.end;
+        if (chunk.result == 0) {
+            stream.replaying = true;
+            return true;
+        }
+        chunks[m].reset();
+    }
+
+    // a real error, lex again on this thread so it is reported with the right location
+    stream.packed.clear();
+    src.lines.resize(1);
+    src.escapes.clear();
+    src.strings.clear();
+    int64_t i = 0;
+    Token token;
+    int result;
+    while ((result = lexToken(src, file, i, token, std::cerr)) > 0);
+    return false;
 }
+#pragma endregion
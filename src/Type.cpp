@@ -1,58 +1,196 @@
 #include <LynxConf.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 #pragma region Type
-bool Type::validate(ConfigEntry* what, const std::vector<std::string>& flags, std::ostream& out) {
-    if (this->type == EntryType::Any) {
-        return true;
-    }
+// Lists with fewer elements than this are checked on one thread.
+#define PARALLEL_ELEMENTS 1024
 
-    bool hasError = false;
+static unsigned validateThreads(size_t size) {
+    unsigned threads = std::thread::hardware_concurrency();
+    if (const char* env = getenv("LYNX_THREADS")) {
+        threads = atoi(env);
+    }
+    threads = std::min<size_t>(threads, size / PARALLEL_ELEMENTS);
+    return std::max(threads, 1u);
+}
 
-    bool optional = this->isOptional || std::find(flags.begin(), flags.end(), "optional") != flags.end();
-    if (what->getType() != this->type) {
-        LYNX_RT_ERR_TO(out) << "Invalid entry type. Expected " << this->type << " but got " << what->getType() << std::endl;
-        return false;
+// Fills in the step at the specified index, the steps of the types in the type are added at the end.
+static void compileCheck(const Type* type, uint32_t at, std::vector<Type::Check>& checks) {
+    if (!type) {
+        checks[at].type = EntryType::Any;
+        return;
     }
-    
-    if (what->getType() == EntryType::List) {
-        ListEntry* list = ((ListEntry*) what);
-        if (list->isEmpty()) {
-            return true;
+    checks[at].type = type->type;
+    checks[at].isOptional = type->isOptional;
+    if (type->type == EntryType::List) {
+        uint32_t element = checks.size();
+        checks[at].next = element;
+        checks.emplace_back();
+        compileCheck(type->listType, element, checks);
+    } else if (type->type == EntryType::Compound && type->compoundTypes) {
+        uint32_t first = checks.size();
+        uint32_t count = type->compoundTypes->size();
+        checks[at].next = first;
+        checks[at].count = count;
+        checks.resize(first + count);
+        for (uint32_t k = 0; k < count; k++) {
+            checks[first + k].key = type->compoundTypes->at(k).key;
+            compileCheck(type->compoundTypes->at(k).type, first + k, checks);
         }
-        if (list->getListType() == EntryType::Invalid) {
-            LYNX_RT_ERR_TO(out) << "Invalid entry type in list '" << what->getKey() << "'. Expected " << this->listType->type << " but got Invalid" << std::endl;
-            return false;
+    }
+}
+
+void Type::compile() {
+    std::vector<Check> checks(1);
+    compileCheck(this, 0, checks);
+    // the steps live as long as the type does
+    this->checks = new Check[checks.size()];
+    std::copy(checks.begin(), checks.end(), this->checks);
+}
+
+// Checks an entry with the steps starting at the specified one. Without a stream nothing is reported, the check
+// stops at the first error and members that are not evaluated yet fail instead of being evaluated, so it can run on
+// any thread.
+static bool runCheck(const Type::Check* checks, uint32_t at, ConfigEntry* what, bool optional, std::ostream* out);
+
+static void reportElement(std::ostream& out, ListEntry* list, size_t n, EntryType type, ConfigEntry* value) {
+    LYNX_RT_ERR_TO(out) << "Invalid entry in list '" << list->getKey() << "' at index " << n;
+    if (value->getType() != type) {
+        out << ". Expected " << type << " but got " << value->getType();
+    }
+    out << std::endl;
+}
+
+static bool runListCheck(const Type::Check* checks, const Type::Check& check, ListEntry* list, bool optional, std::ostream* out) {
+    if (list->isEmpty()) {
+        return true;
+    }
+    const Type::Check& element = checks[check.next];
+    if (list->getListType() == EntryType::Invalid) {
+        if (out) {
+            LYNX_RT_ERR_TO(*out) << "Invalid entry type in list '" << list->getKey() << "'. Expected " << element.type << " but got Invalid" << std::endl;
         }
-        if (!this->listType->validate(list->get(0), flags, out)) {
-            LYNX_RT_ERR_TO(out) << "Invalid entry type in list '" << what->getKey() << "'. Expected " << this->listType->type << " but got " << list->getListType() << std::endl;
-            hasError = true;
+        return false;
+    }
+    if (element.type == EntryType::Any) {
+        return true;
+    }
+    if (element.type != EntryType::List && element.type != EntryType::Compound && list->getListType() == element.type) {
+        // the elements all have the type of the list
+        return true;
+    }
+
+    size_t size = list->size();
+    unsigned threads = out && (element.type == EntryType::List || element.type == EntryType::Compound) ? validateThreads(size) : 1;
+    if (threads == 1) {
+        for (size_t n = 0; n < size; n++) {
+            ConfigEntry* value = list->get(n);
+            if (!runCheck(checks, check.next, value, optional, out)) {
+                if (out) {
+                    reportElement(*out, list, n, element.type, value);
+                }
+                return false;
+            }
         }
-    } else if (what->getType() == EntryType::Compound) {
-        CompoundEntry* compound = ((CompoundEntry*) what);
-        for (size_t i = 0; i < this->compoundTypes->size(); i++) {
-            Type::CompoundType compoundType = this->compoundTypes->at(i);
-            if (!compound->hasMember(compoundType.key)) {
-                if (optional || compoundType.type->isOptional) {
-                    continue;
+        return true;
+    }
+
+    // the threads only find the elements that failed or have members that are not evaluated yet
+    size_t count = threads * 4;
+    std::vector<std::vector<size_t>> failed(count);
+    std::atomic<size_t> nextChunk = 0;
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([&]() {
+            for (size_t k; (k = nextChunk++) < count;) {
+                for (size_t n = size * k / count; n < size * (k + 1) / count; n++) {
+                    if (!runCheck(checks, check.next, list->get(n), optional, nullptr)) {
+                        failed[k].push_back(n);
+                    }
                 }
-                LYNX_RT_ERR_TO(out) << "Missing property '" << compoundType.key << "' in compound '" << what->getKey() << "'" << std::endl;
-                hasError = true;
-                continue;
             }
-            if (!compoundType.type->validate(compound->get(compoundType.key), flags, out)) {
-                LYNX_RT_ERR_TO(out) << "Member '" << compoundType.key << "' of compound '" << what->getKey() << "' is type " << compound->get(compoundType.key)->getType() << " but expected " << compoundType.type->type << std::endl;
-                hasError = true;
+        });
+    }
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    // which are checked again here in order, so members are evaluated and errors reported like on one thread
+    for (auto& chunk : failed) {
+        for (size_t n : chunk) {
+            ConfigEntry* value = list->get(n);
+            if (!runCheck(checks, check.next, value, optional, out)) {
+                reportElement(*out, list, n, element.type, value);
+                return false;
             }
         }
-    } else if (what->getType() == EntryType::String) {
+    }
+    return true;
+}
+
+static bool runCheck(const Type::Check* checks, uint32_t at, ConfigEntry* what, bool optional, std::ostream* out) {
+    const Type::Check& check = checks[at];
+    if (check.type == EntryType::Any) {
         return true;
-    } else if (what->getType() == EntryType::Number) {
+    }
+    if (what->getType() != check.type) {
+        if (out) {
+            LYNX_RT_ERR_TO(*out) << "Invalid entry type. Expected " << check.type << " but got " << what->getType() << std::endl;
+        }
+        return false;
+    }
+    if (check.type == EntryType::List) {
+        return runListCheck(checks, check, (ListEntry*) what, optional, out);
+    }
+    if (check.type != EntryType::Compound) {
         return true;
     }
-    return !hasError;
+
+    CompoundEntry* compound = ((CompoundEntry*) what);
+    bool valid = true;
+    for (uint32_t k = check.next; k < check.next + check.count; k++) {
+        const Type::Check& member = checks[k];
+        ConfigEntry* value = compound->peek(member.key);
+        if (!value) {
+            if (optional || check.isOptional || member.isOptional) {
+                continue;
+            }
+            if (!out) {
+                return false;
+            }
+            LYNX_RT_ERR_TO(*out) << "Missing property '" << member.key << "' in compound '" << what->getKey() << "'" << std::endl;
+            valid = false;
+            continue;
+        }
+        if (value->getType() == EntryType::Thunk) {
+            if (!out) {
+                return false;
+            }
+            value = compound->get(member.key);
+            if (!value) {
+                // a deferred member that failed to evaluate, it has been reported already
+                valid = false;
+                continue;
+            }
+        }
+        if (!runCheck(checks, k, value, optional, out)) {
+            if (!out) {
+                return false;
+            }
+            LYNX_RT_ERR_TO(*out) << "Member '" << member.key << "' of compound '" << what->getKey() << "' is type " << value->getType() << " but expected " << member.type << std::endl;
+            valid = false;
+        }
+    }
+    return valid;
+}
+
+bool Type::validate(ConfigEntry* what, const std::vector<std::string>& flags, std::ostream& out) {
+    bool optional = !flags.empty() && std::find(flags.begin(), flags.end(), "optional") != flags.end();
+    return runCheck(this->checks, 0, what, optional, &out);
 }
 
 std::string Type::toString() const {
@@ -107,99 +245,92 @@ std::string Type::toString() const {
 }
 
 bool Type::operator==(const Type& other) const {
-    if (this->type != other.type) return false;
-    switch (this->type) {
-        case EntryType::List: return (*(this->listType) == (*other.listType));
-        case EntryType::Function: [[fallthrough]];
-        case EntryType::Compound: {
-            if (!this->compoundTypes || !other.compoundTypes) {
-                return false;
-            }
-            if (this->compoundTypes->size() != other.compoundTypes->size()) {
-                return false;
-            }
-            for (size_t i = 0; i < this->compoundTypes->size(); i++) {
-                if (this->compoundTypes->at(i).key != other.compoundTypes->at(i).key) {
-                    return false;
-                }
-                if (!this->compoundTypes->at(i).type->operator==(*other.compoundTypes->at(i).type)) {
-                    return false;
-                }
-            }
-            return true;
-        }
-        default: return true;
-    }
+    return this == &other;
 }
 
 bool Type::operator!=(const Type& other) const {
     return !operator==(other);
 }
 
-Type* Type::clone() {
-    Type* t = new Type();
-    t->type = this->type;
-    if (this->listType) t->listType = this->listType->clone();
-    if (this->compoundTypes) {
-        t->compoundTypes = new std::vector<CompoundType>();
-        *t->compoundTypes = *this->compoundTypes;
-    }
-    return t;
-}
-
 bool Type::CompoundType::operator==(const Type::CompoundType& other) const {
-    return this->key == other.key && this->type->operator==(*other.type);
+    return this->key == other.key && this->type == other.type;
 }
 
 bool Type::CompoundType::operator!=(const Type::CompoundType& other) const {
     return !operator==(other);
 }
 
+// The interned types by a hash of their structure. The types in a type are interned first, so two types are equal
+// if they point to the same ones.
+struct TypeTable {
+    std::mutex mutex;
+    std::unordered_multimap<uint64_t, Type*> types;
+};
+
+static TypeTable& types() {
+    static TypeTable table;
+    return table;
+}
+
+Type* Type::get(EntryType type, Type* listType, const std::vector<CompoundType>& compoundTypes, bool isOptional) {
+    bool members = type == EntryType::Compound || type == EntryType::Function;
+    if (type != EntryType::List) {
+        listType = nullptr;
+    }
+    uint64_t hash = (uint64_t) type * 31 + isOptional;
+    hash = hash * 1099511628211u ^ (uintptr_t) listType;
+    if (members) {
+        for (const CompoundType& member : compoundTypes) {
+            hash = hash * 1099511628211u ^ member.key.id;
+            hash = hash * 1099511628211u ^ (uintptr_t) member.type;
+        }
+    }
+
+    TypeTable& table = types();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    auto range = table.types.equal_range(hash);
+    for (auto found = range.first; found != range.second; found++) {
+        Type* t = found->second;
+        if (t->type == type && t->isOptional == isOptional && t->listType == listType && (!members || *t->compoundTypes == compoundTypes)) {
+            return t;
+        }
+    }
+    Type* t = new Type();
+    t->type = type;
+    t->listType = listType;
+    t->compoundTypes = members ? new std::vector<CompoundType>(compoundTypes) : nullptr;
+    t->isOptional = isOptional;
+    t->compile();
+    table.types.emplace(hash, t);
+    return t;
+}
+
 Type* Type::String() {
-    Type* type = new Type();
-    type->type = EntryType::String;
-    return type;
+    return Type::get(EntryType::String);
 }
 
 Type* Type::Number() {
-    Type* type = new Type();
-    type->type = EntryType::Number;
-    return type;
+    return Type::get(EntryType::Number);
 }
 
 Type* Type::List(Type* type) {
-    Type* t = new Type();
-    t->type = EntryType::List;
-    t->listType = type;
-    return t;
+    return Type::get(EntryType::List, type);
 }
 
 Type* Type::Compound(std::vector<CompoundType> types) {
-    Type* type = new Type();
-    type->type = EntryType::Compound;
-    type->compoundTypes = new std::vector<CompoundType>();
-    for (const auto& compoundType : types) {
-        type->compoundTypes->push_back(compoundType);
-    }
-    return type;
+    return Type::get(EntryType::Compound, nullptr, types);
 }
 
 Type* Type::Function(std::vector<CompoundType> types) {
-    Type* type = Type::Compound(types);
-    type->type = EntryType::Function;
-    return type;
+    return Type::get(EntryType::Function, nullptr, types);
 }
 
 Type* Type::Optional(Type* type) {
-    Type* t = type->clone();
-    t->isOptional = true;
-    return t;
+    return Type::get(type->type, type->listType, type->compoundTypes ? *type->compoundTypes : std::vector<CompoundType>(), true);
 }
 
 Type* Type::Any() {
-    Type* type = new Type();
-    type->type = EntryType::Any;
-    return type;
+    return Type::get(EntryType::Any);
 }
 
 #pragma endregion
@@ -235,8 +366,9 @@ void TypeEntry::print(std::ostream& stream, int indent) const {
 
 ConfigEntry* TypeEntry::clone() {
     TypeEntry* entry = new TypeEntry();
-    entry->setKey(this->getKey());
-    entry->type = this->type->clone();
+    entry->setKey(this->getSymbol());
+    ConfigEntry::clones++;
+    entry->type = this->type;
     return ((ConfigEntry*) entry);
 }
 #pragma endregion
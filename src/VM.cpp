@@ -0,0 +1,1893 @@
+#include <LynxConf.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+
+// A bytecode compiler and register VM for blocks in stored token lists.
+//
+// How many arguments a call takes is only known once the function is looked up, so a block is compiled the first
+// time it runs, with the arity of every function it calls at that moment. Names the block binds itself (compound
+// keys, for variables and set) are tracked while compiling, the others are checked again before each run and the
+// block is recompiled if one changed. Every call site also checks the arity of the function it finds. If that
+// check fails before anything with side effects ran, the block falls back to the nodes for good.
+//
+// Calls of pure natives on constants are folded while compiling. Calls of pure natives on paths the block does not
+// bind differently keep their value in a slot: inside a loop the first iteration computes it and the others reuse
+// it, and outside of one a later occurrence of the same call reuses it. Slots are only read if they were filled
+// during the same run, so a call that is skipped by a branch is computed where it runs next.
+
+bool sumEntries(ConfigEntry* finalEntry, ConfigEntry* entry);
+bool addBlockEntry(ConfigEntry*& finalEntry, ConfigEntry* entry, TokenList& tokens, int i);
+
+// Direct threading needs computed goto, everything else dispatches with a switch.
+#if defined(__GNUC__) || defined(__clang__)
+#define LYNX_VM_THREADED
+#endif
+
+#define VM_ERR LYNX_RT_ERR << tokens.location(base + pc->token) << ": "
+
+#define LYNX_OPS(X) \
+    X(String) X(Number) X(EmptyString) X(Path) X(This) X(Lookup) X(Call) X(Native) X(Arith) X(BranchArith) \
+    X(Branch) X(Jump) X(BlockAdd) X(List) X(ListAdd) X(Compound) X(CompoundType) X(CompoundSet) X(CompoundEnd) \
+    X(Func) X(ForBegin) X(ForNext) X(ForStep) X(ForEnd) X(Match) X(NoMatch) X(Exists) X(Set) X(Try) X(EndTry) \
+    X(Reuse) X(Keep) X(Return)
+
+#define OP_ENUM(_name) _name,
+enum class Op : uint8_t { LYNX_OPS(OP_ENUM) };
+#undef OP_ENUM
+
+// The natives run inline by the Arith and BranchArith superinstructions.
+enum class Arith : uint8_t { Add, Sub, Mul, Div, Gt, Lt, Ge, Le, Or, And, Mod, Eq, Ne, Not, Inc, Dec };
+
+static const std::unordered_map<std::string, Arith> arithNatives {
+    {"add", Arith::Add}, {"sub", Arith::Sub}, {"mul", Arith::Mul}, {"div", Arith::Div},
+    {"gt", Arith::Gt}, {"lt", Arith::Lt}, {"ge", Arith::Ge}, {"le", Arith::Le},
+    {"or", Arith::Or}, {"and", Arith::And}, {"mod", Arith::Mod}, {"eq", Arith::Eq}, {"ne", Arith::Ne},
+    {"not", Arith::Not}, {"inc", Arith::Inc}, {"dec", Arith::Dec},
+};
+
+#define isUnary(_op) ((_op) == Arith::Not || (_op) == Arith::Inc || (_op) == Arith::Dec)
+
+// An operand of an arithmetic instruction is a register, a constant or a path that is read without cloning it.
+// The kind is kept in the top two bits.
+#define OPERAND_REGISTER 0u
+#define OPERAND_NUMBER 1u
+#define OPERAND_STRING 2u
+#define OPERAND_PATH 3u
+#define makeOperand(_kind, _index) (((_kind) << 30) | (uint32_t) (_index))
+#define operandKind(_operand) ((_operand) >> 30)
+#define operandIndex(_operand) ((_operand) & 0x3FFFFFFFu)
+
+// Token indices in a chunk are relative to the start of the block, the same block is reached through
+// slices that start at different offsets.
+struct Instruction {
+    const void* handler;
+    Op op;
+    uint8_t sub;
+    uint16_t a;
+    uint32_t b;
+    uint32_t c;
+    uint32_t d;
+    int32_t token;
+};
+
+// A path that is loaded or called, with the arity the block was compiled for.
+struct Site {
+    ScopePath path;
+    NativeFunctionEntry* native;
+    size_t arity;
+    // the names of named arguments, empty for positional ones
+    std::vector<Symbol> names;
+    // true if no argument is named, the arguments are passed in the registers they were computed in
+    bool positional = true;
+};
+
+struct FunctionProto {
+    // the name and the token of the type of each argument
+    std::vector<std::pair<std::string, int>> args;
+    int bodyStart;
+    int bodyEnd;
+};
+
+// A name the block does not bind, and the arity it had when the block was compiled.
+struct Guard {
+    ScopePath path;
+    size_t arity;
+};
+
+struct Chunk {
+    std::vector<Instruction> code;
+    std::vector<std::string> strings;
+    // the keys entries are set to
+    std::vector<Symbol> symbols;
+    std::vector<double> numbers;
+    // the paths read by operands and exists
+    std::vector<ScopePath> paths;
+    std::vector<Site> sites;
+    std::vector<FunctionProto> functions;
+    std::vector<Guard> guards;
+    uint32_t registers = 0;
+    uint32_t loops = 0;
+    // the slots that keep values between the instructions that compute and reuse them
+    uint32_t kept = 0;
+    // the offset of the block end from the block start
+    int length = 0;
+    bool threaded = false;
+};
+
+static ConfigEntry* findByPath(const std::string& path, std::vector<CompoundEntry*>& compoundStack) {
+    for (size_t i = compoundStack.size(); i > 0; i--) {
+        ConfigEntry* entry = compoundStack[i - 1]->getByPath(path);
+        if (entry) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+static size_t arityOf(ConfigEntry* entry) {
+    if (entry && entry->getType() == EntryType::Function) {
+        return ((FunctionEntry*) entry)->args.size();
+    }
+    return 0;
+}
+
+#pragma region Compiler
+// What the compiler knows about a name the block binds.
+struct Shape {
+    enum Kind { Unknown, Value, Function, Compound } kind = Unknown;
+    size_t arity = 0;
+    std::shared_ptr<std::map<std::string, Shape>> members;
+};
+
+// A loop being compiled, and the scope of its loop variable.
+struct OpenLoop {
+    uint32_t loop;
+    size_t scope;
+};
+
+// A call whose value is kept in a slot, and the names its paths start with.
+struct KeptValue {
+    uint32_t slot;
+    // the loop whose iterations reuse it, -1 for the whole run
+    int64_t home;
+    std::vector<std::string> heads;
+};
+
+struct Compiler {
+    ConfigParser* parser;
+    TokenList& tokens;
+    std::vector<CompoundEntry*>& compoundStack;
+    Chunk* chunk;
+    // the index of the block start, token indices in the chunk are relative to it
+    int base;
+    // scopes[0] is the compound on top of the stack when the block starts
+    std::vector<std::map<std::string, Shape>> scopes;
+    std::unordered_map<std::string, size_t> guarded;
+    // the arities free names had when the chunk being replaced was compiled
+    std::unordered_map<std::string, size_t> previous;
+    // the arities call sites found at runtime, by token
+    const std::unordered_map<int32_t, size_t>& overrides;
+    uint32_t next = 0;
+    int conditional = 0;
+    bool failed = false;
+    // set by resolve if the path goes through a name the block binds to something unknown
+    bool dynamic = false;
+    // the shape of the last compiled expression
+    Shape shape;
+    std::vector<OpenLoop> open;
+    // by the loop they are kept for and their tokens
+    std::unordered_map<std::string, KeptValue> kept;
+    // set while compiling a call whose value is kept, the calls in it are not kept on their own
+    bool keeping = false;
+
+    Compiler(ConfigParser* parser, TokenList& tokens, std::vector<CompoundEntry*>& compoundStack, Chunk* chunk, int base, const std::unordered_map<int32_t, size_t>& overrides)
+        : parser(parser), tokens(tokens), compoundStack(compoundStack), chunk(chunk), base(base), overrides(overrides) {
+        this->scopes.emplace_back();
+    }
+
+    size_t emit(Op op, int token, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, uint32_t d = 0, uint8_t sub = 0) {
+        if (a > UINT16_MAX) {
+            this->failed = true;
+        }
+        this->chunk->code.push_back({nullptr, op, sub, (uint16_t) a, b, c, d, token - this->base});
+        return this->chunk->code.size() - 1;
+    }
+
+    uint32_t here() const {
+        return this->chunk->code.size();
+    }
+
+    void patch(size_t at) {
+        this->chunk->code[at].d = this->here();
+    }
+
+    uint32_t allocate() {
+        uint32_t r = this->next++;
+        if (this->next > this->chunk->registers) {
+            this->chunk->registers = this->next;
+        }
+        return r;
+    }
+
+    uint32_t string(const std::string& value) {
+        this->chunk->strings.push_back(value);
+        return this->chunk->strings.size() - 1;
+    }
+
+    uint32_t symbol(Symbol key) {
+        this->chunk->symbols.push_back(key);
+        return this->chunk->symbols.size() - 1;
+    }
+
+    uint32_t scope(const std::string& path) {
+        this->chunk->paths.emplace_back(path);
+        return this->chunk->paths.size() - 1;
+    }
+
+    uint32_t number(double value) {
+        this->chunk->numbers.push_back(value);
+        return this->chunk->numbers.size() - 1;
+    }
+
+    uint32_t site(const Site& site) {
+        this->chunk->sites.push_back(site);
+        return this->chunk->sites.size() - 1;
+    }
+
+    bool is(int i, int type) const {
+        return this->tokens.has(i) && this->tokens[i].type == type;
+    }
+
+    bool fail() {
+        this->failed = true;
+        return false;
+    }
+
+    // Joins a dotted path like makePath and leaves i on its last token.
+    bool path(int& i, std::string& path) {
+        path = this->tokens.value(i);
+        while (this->is(i + 1, Token::Dot)) {
+            if (!this->is(i + 2, Token::Identifier)) {
+                return this->fail();
+            }
+            path += ".";
+            path += this->tokens.value(i + 2);
+            i += 2;
+        }
+        return true;
+    }
+
+    // Skips a type like parseType does and leaves i on its last token.
+    bool skipType(int& i) {
+        if (!this->is(i, Token::Identifier)) {
+            return this->fail();
+        }
+        if (this->tokens.value(i) == "optional") {
+            i++;
+        }
+        std::string_view name = this->tokens.value(i);
+        if (name == "string" || name == "number" || name == "any") {
+            return true;
+        }
+        if (name == "list") {
+            i++;
+            if (!this->is(i, Token::ListStart)) {
+                return this->fail();
+            }
+            i++;
+            if (!this->skipType(i)) {
+                return false;
+            }
+            i++;
+            return true;
+        }
+        if (name == "compound") {
+            i++;
+            if (!this->is(i, Token::CompoundStart)) {
+                return this->fail();
+            }
+            i++;
+            while (this->tokens.has(i) && this->tokens[i].type != Token::CompoundEnd) {
+                if (!this->is(i, Token::Identifier) || !this->is(i + 1, Token::Is)) {
+                    return this->fail();
+                }
+                i += 2;
+                if (!this->skipType(i)) {
+                    return false;
+                }
+                i++;
+            }
+            return this->tokens.has(i) || this->fail();
+        }
+        std::string ignored;
+        return this->is(i, Token::Identifier) ? this->path(i, ignored) : this->fail();
+    }
+
+    void bind(const std::string& key, const Shape& shape) {
+        // a name bound in an if or a switch case may or may not be there later
+        this->scopes.back()[key] = this->conditional ? Shape() : shape;
+        this->forget(key);
+    }
+
+    // Stops reusing the kept values of calls that read a name, once it means something else.
+    void forget(const std::string& key) {
+        for (auto value = this->kept.begin(); value != this->kept.end();) {
+            auto& heads = value->second.heads;
+            if (std::find(heads.begin(), heads.end(), key) != heads.end()) {
+                value = this->kept.erase(value);
+            } else {
+                value++;
+            }
+        }
+    }
+
+    // Pops a scope, the names it bound mean what they meant before it again.
+    void leave() {
+        for (auto& name : this->scopes.back()) {
+            this->forget(name.first);
+        }
+        this->scopes.pop_back();
+    }
+
+    // Returns the arity to compile a path for. Names the block binds are looked up in the scopes first, like
+    // byPath walks the stack, anything else is looked up now and guarded.
+    size_t resolve(const std::string& path) {
+        this->dynamic = false;
+        std::string head = path.substr(0, path.find('.'));
+        for (size_t s = this->scopes.size(); s > 0; s--) {
+            auto found = this->scopes[s - 1].find(head);
+            if (found == this->scopes[s - 1].end()) {
+                continue;
+            }
+            const Shape* shape = &found->second;
+            size_t at = head.size();
+            while (shape && at < path.size() && shape->kind == Shape::Compound) {
+                size_t dot = path.find('.', at + 1);
+                size_t end = dot == std::string::npos ? path.size() : dot;
+                auto member = shape->members->find(path.substr(at + 1, end - at - 1));
+                shape = member != shape->members->end() ? &member->second : nullptr;
+                at = end;
+            }
+            if (!shape || (at < path.size() && shape->kind != Shape::Unknown)) {
+                // the rest of the path is not in this compound, the lookup goes on below it
+                continue;
+            }
+            // unknown names are checked where they are used
+            this->dynamic = shape->kind == Shape::Unknown;
+            return shape->kind == Shape::Function ? shape->arity : 0;
+        }
+        auto known = this->previous.find(path);
+        size_t arity = known != this->previous.end() ? known->second : arityOf(findByPath(path, this->compoundStack));
+        if (this->guarded.emplace(path, arity).second) {
+            this->chunk->guards.push_back({path, arity});
+        }
+        return arity;
+    }
+
+    // Compiles the expression at i into a new register and leaves i on its last token.
+    uint32_t expr(int& i) {
+        uint32_t target = this->allocate();
+        this->shape = Shape();
+        if (!this->tokens.has(i)) {
+            this->fail();
+            return target;
+        }
+        switch (this->tokens[i].type) {
+            case Token::String:
+                this->emit(Op::String, i, target, this->string(std::string(this->tokens.value(i))));
+                this->shape.kind = Shape::Value;
+                break;
+            case Token::Number: {
+                double value;
+                try {
+                    value = std::stod(std::string(this->tokens.value(i)));
+                } catch (const std::exception& e) {
+                    // the nodes report it
+                    this->fail();
+                    break;
+                }
+                this->emit(Op::Number, i, target, this->number(value));
+                this->shape.kind = Shape::Value;
+                break;
+            }
+            case Token::ListStart: this->list(i, target); break;
+            case Token::CompoundStart: this->compound(i, target); break;
+            case Token::BlockStart: this->block(i, target); break;
+            case Token::Dot:
+                this->emit(Op::This, i, target);
+                break;
+            case Token::Identifier: {
+                if (findBuiltin(this->tokens[i].symbol)) {
+                    this->builtin(std::string(this->tokens.value(i)), i, target);
+                } else if (!this->folded(i, target) && !this->reuse(i, target)) {
+                    this->call(i, target);
+                }
+                break;
+            }
+            default:
+                this->fail();
+        }
+        this->next = target + 1;
+        return target;
+    }
+
+    void list(int& i, uint32_t target) {
+        this->emit(Op::List, i, target);
+        i++;
+        while (!this->failed && this->tokens.has(i) && this->tokens[i].type != Token::ListEnd) {
+            uint32_t value = this->expr(i);
+            this->emit(Op::ListAdd, i, target, value);
+            i++;
+        }
+        if (!this->tokens.has(i)) {
+            this->fail();
+        }
+        this->shape = Shape();
+        this->shape.kind = Shape::Value;
+    }
+
+    void compound(int& i, uint32_t target) {
+        size_t start = this->emit(Op::Compound, i, target);
+        this->scopes.emplace_back();
+        i++;
+        while (!this->failed && this->tokens.has(i) && this->tokens[i].type != Token::CompoundEnd) {
+            if (this->tokens[i].type == Token::BlockStart) {
+                // a merge, its value is not used
+                i++;
+                this->expr(i);
+                i++;
+                if (!this->is(i, Token::BlockEnd)) {
+                    this->fail();
+                }
+                i++;
+                continue;
+            }
+            if (this->tokens[i].type != Token::Identifier) {
+                this->fail();
+                break;
+            }
+            std::string key(this->tokens.value(i));
+            i++;
+            if (this->is(i, Token::Is)) {
+                i++;
+                int type = i;
+                if (!this->skipType(i)) {
+                    break;
+                }
+                this->emit(Op::CompoundType, type, target, this->symbol(key), type - this->base);
+                Shape value;
+                value.kind = Shape::Value;
+                this->bind(key, value);
+                i++;
+                if (!this->is(i, Token::Assign)) {
+                    continue;
+                }
+            } else if (!this->is(i, Token::Assign)) {
+                this->fail();
+                break;
+            }
+            i++;
+            uint32_t value = this->expr(i);
+            this->emit(Op::CompoundSet, i, target, this->symbol(key), value);
+            this->bind(key, this->shape);
+            i++;
+        }
+        if (!this->tokens.has(i)) {
+            this->fail();
+        }
+        this->emit(Op::CompoundEnd, i, target);
+        // the compound makes room for the keys it sets up front
+        this->chunk->code[start].b = this->scopes.back().size();
+        this->shape = Shape();
+        this->shape.kind = Shape::Compound;
+        for (auto& name : this->scopes.back()) {
+            this->forget(name.first);
+        }
+        this->shape.members = std::make_shared<std::map<std::string, Shape>>(std::move(this->scopes.back()));
+        this->scopes.pop_back();
+    }
+
+    void block(int& i, uint32_t target) {
+        int start = i;
+        i++;
+        this->next = target;
+        this->expr(i);
+        i++;
+        while (!this->failed && this->tokens.has(i) && this->tokens[i].type != Token::BlockEnd) {
+            uint32_t value = this->expr(i);
+            i++;
+            this->emit(Op::BlockAdd, i, target, value);
+        }
+        if (!this->tokens.has(i) || (size_t) i != this->tokens.blockEnd(start)) {
+            this->fail();
+        }
+        this->shape = Shape();
+    }
+
+    // Compiles the body of an if or a switch case into target. Like captureBlock, a body that is not a block is
+    // a single token, bodies that would read past it are left to the nodes.
+    void branch(int& i, uint32_t target) {
+        this->next = target;
+        this->conditional++;
+        if (this->is(i, Token::BlockStart) || this->is(i, Token::String) || this->is(i, Token::Number)) {
+            this->expr(i);
+        } else if (this->is(i, Token::Identifier) && !this->is(i + 1, Token::Dot)) {
+            std::string name(this->tokens.value(i));
+            NativeFunctionEntry* native = findNative(this->tokens[i].symbol);
+            if (name == "true" || name == "false") {
+                this->expr(i);
+            } else if (findBuiltin(this->tokens[i].symbol)) {
+                this->fail();
+            } else if (native ? native->args.empty() : this->resolve(name) == 0 && !this->dynamic) {
+                this->expr(i);
+            } else {
+                this->fail();
+            }
+        } else {
+            this->fail();
+        }
+        this->conditional--;
+        this->next = target + 1;
+    }
+
+    void builtin(const std::string& name, int& i, uint32_t target) {
+        if (name == "true" || name == "false") {
+            this->emit(Op::Number, i, target, this->number(name == "true" ? 1 : 0));
+            this->shape.kind = Shape::Value;
+        } else if (name == "exists") {
+            i++;
+            std::string path;
+            if (!this->is(i, Token::Identifier) || !this->path(i, path)) {
+                this->fail();
+                return;
+            }
+            this->emit(Op::Exists, i, target, this->scope(path));
+            this->shape.kind = Shape::Value;
+        } else if (name == "set") {
+            i++;
+            if (!this->is(i, Token::Identifier)) {
+                this->fail();
+                return;
+            }
+            std::string key(this->tokens.value(i));
+            i++;
+            this->next = target;
+            this->expr(i);
+            this->emit(Op::Set, i, target, this->symbol(key));
+            this->bind(key, this->shape);
+        } else if (name == "func") {
+            this->func(i, target);
+        } else if (name == "if") {
+            this->ifElse(i, target);
+        } else if (name == "for") {
+            this->forIn(i, target);
+        } else if (name == "switch") {
+            this->switchCase(i, target);
+        } else {
+            this->fail();
+        }
+    }
+
+    void func(int& i, uint32_t target) {
+        int start = i;
+        FunctionProto proto;
+        i++;
+        if (!this->is(i, Token::BlockStart)) {
+            this->fail();
+            return;
+        }
+        i++;
+        while (this->tokens.has(i) && this->tokens[i].type != Token::BlockEnd) {
+            if (!this->is(i, Token::Identifier) || !this->is(i + 1, Token::Is)) {
+                this->fail();
+                return;
+            }
+            std::string name(this->tokens.value(i));
+            i += 2;
+            proto.args.push_back({name, i - this->base});
+            if (!this->skipType(i)) {
+                return;
+            }
+            i++;
+        }
+        i++;
+        if (!this->is(i, Token::BlockStart)) {
+            this->fail();
+            return;
+        }
+        proto.bodyStart = i - this->base;
+        i = this->tokens.blockEnd(i);
+        proto.bodyEnd = i - this->base;
+        this->chunk->functions.push_back(proto);
+        this->emit(Op::Func, start, target, this->chunk->functions.size() - 1);
+        this->shape = Shape();
+        this->shape.kind = Shape::Function;
+        this->shape.arity = proto.args.size();
+    }
+
+    // Compiles a condition and a branch that is taken when it is false, and returns the branch.
+    size_t condition(int& i, uint32_t target) {
+        if (this->is(i, Token::Identifier) && !this->is(i + 1, Token::Dot)) {
+            std::string name(this->tokens.value(i));
+            auto arith = arithNatives.find(name);
+            if (arith != arithNatives.end()) {
+                uint32_t a, b;
+                int start = i;
+                if (this->arithOperands(i, arith->second, a, b)) {
+                    NativeFunctionEntry* native = findNative(this->tokens[start].symbol);
+                    uint32_t site = this->site({name, native, native->args.size(), std::vector<Symbol>(native->args.size())});
+                    return this->emit(Op::BranchArith, i, site, a, b, 0, (uint8_t) arith->second);
+                }
+                if (this->failed) {
+                    return 0;
+                }
+                i = start;
+            }
+        }
+        this->next = target;
+        uint32_t value = this->expr(i);
+        return this->emit(Op::Branch, i + 1, value);
+    }
+
+    void ifElse(int& i, uint32_t target) {
+        i++;
+        this->next = target;
+        size_t otherwise = this->condition(i, target);
+        i++;
+        this->branch(i, target);
+        size_t end = this->emit(Op::Jump, i);
+        this->patch(otherwise);
+        if (this->tokens.has(i + 1) && this->tokens[i + 1].type == Token::Identifier && this->tokens.value(i + 1) == "else") {
+            i += 2;
+            this->branch(i, target);
+        } else {
+            this->emit(Op::EmptyString, i, target);
+        }
+        this->patch(end);
+        this->shape = Shape();
+    }
+
+    void forIn(int& i, uint32_t target) {
+        i++;
+        if (!this->is(i, Token::Identifier) || !this->is(i + 1, Token::Identifier) || this->tokens.value(i + 1) != "in") {
+            this->fail();
+            return;
+        }
+        std::string iterVar(this->tokens.value(i));
+        i += 2;
+        // a list that fails to evaluate is an empty list
+        size_t handler = this->emit(Op::Try, i);
+        this->next = target + 1;
+        uint32_t list = this->expr(i);
+        this->emit(Op::EndTry, i);
+        size_t skip = this->emit(Op::Jump, i);
+        this->patch(handler);
+        this->emit(Op::List, i, list);
+        this->patch(skip);
+        i++;
+        if (!this->is(i, Token::BlockStart)) {
+            this->fail();
+            return;
+        }
+        uint32_t loop = this->chunk->loops++;
+        size_t begin = this->emit(Op::ForBegin, i, list, loop);
+        uint32_t top = this->here();
+        size_t exit = this->emit(Op::ForNext, i, list, loop, this->symbol(iterVar));
+        this->scopes.emplace_back();
+        this->scopes.back()[iterVar] = Shape();
+        this->open.push_back({loop, this->scopes.size() - 1});
+        uint32_t slots = this->chunk->kept;
+        this->next = target + 2;
+        uint32_t body = this->expr(i);
+        this->open.pop_back();
+        for (auto value = this->kept.begin(); value != this->kept.end();) {
+            value = value->second.home == loop ? this->kept.erase(value) : std::next(value);
+        }
+        this->leave();
+        this->emit(Op::ForStep, i, body, loop, 0, top);
+        this->patch(exit);
+        // the slots filled in the body are emptied when the loop starts and ends
+        this->chunk->code[begin].c = slots;
+        this->chunk->code[begin].d = this->chunk->kept - slots;
+        this->emit(Op::ForEnd, i, target, loop, slots, this->chunk->kept - slots);
+        this->shape = Shape();
+    }
+
+    void switchCase(int& i, uint32_t target) {
+        i++;
+        this->next = target + 1;
+        uint32_t value = this->expr(i);
+        i++;
+        if (!this->is(i, Token::BlockStart)) {
+            this->fail();
+            return;
+        }
+        i++;
+        // every case value is evaluated before a case body runs, the else case has none
+        std::vector<std::pair<int64_t, int>> cases;
+        while (!this->failed && this->tokens.has(i) && this->tokens[i].type != Token::BlockEnd) {
+            int64_t caseValue = -1;
+            if (this->tokens[i].type != Token::Identifier || this->tokens.value(i) != "else") {
+                caseValue = this->expr(i);
+            }
+            i++;
+            if (!this->is(i, Token::Assign)) {
+                this->fail();
+                return;
+            }
+            i++;
+            int body = i;
+            if (this->is(i, Token::BlockStart)) {
+                i = this->tokens.blockEnd(i);
+            }
+            if (!this->tokens.has(i)) {
+                this->fail();
+                return;
+            }
+            cases.push_back({caseValue, body});
+            i++;
+        }
+        if (this->failed || !this->is(i, Token::BlockEnd)) {
+            this->fail();
+            return;
+        }
+        std::vector<size_t> jumps(cases.size(), 0);
+        for (size_t k = 0; k < cases.size(); k++) {
+            if (cases[k].first >= 0) {
+                jumps[k] = this->emit(Op::Match, cases[k].second, value, cases[k].first);
+            }
+        }
+        // only the first else case is ever used
+        size_t fallback = cases.size();
+        for (size_t k = 0; k < cases.size() && fallback == cases.size(); k++) {
+            if (cases[k].first < 0) {
+                fallback = k;
+                jumps[k] = this->emit(Op::Jump, i);
+            }
+        }
+        if (fallback == cases.size()) {
+            this->emit(Op::NoMatch, i);
+        }
+        std::vector<size_t> ends;
+        for (size_t k = 0; k < cases.size(); k++) {
+            if (cases[k].first < 0 && k != fallback) {
+                continue;
+            }
+            this->patch(jumps[k]);
+            int body = cases[k].second;
+            this->branch(body, target);
+            ends.push_back(this->emit(Op::Jump, i));
+        }
+        for (size_t end : ends) {
+            this->patch(end);
+        }
+        this->shape = Shape();
+    }
+
+    // Compiles the arguments of a call to the registers after the target, like parseArgs reads them.
+    bool args(int& i, size_t arity, Site& site, const std::vector<Type::CompoundType>* declared) {
+        for (size_t n = 0; n < arity; n++) {
+            i++;
+            Symbol name;
+            if (this->is(i, Token::Assign)) {
+                i++;
+                name = Symbol(this->tokens.value(i));
+                if (declared) {
+                    bool found = false;
+                    for (auto& arg : *declared) {
+                        found = found || arg.key == name;
+                    }
+                    if (!found) {
+                        // the nodes report the invalid name
+                        return this->fail();
+                    }
+                }
+                i++;
+            }
+            site.names.push_back(name);
+            site.positional = site.positional && name.empty();
+            this->expr(i);
+            if (this->failed) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // True if the expression at i is a constant or a path that is not called and cannot change while the block runs.
+    bool constant(int i) {
+        if (this->is(i, Token::Number) || this->is(i, Token::String)) {
+            return true;
+        }
+        if (!this->is(i, Token::Identifier) || findBuiltin(this->tokens[i].symbol)) {
+            return false;
+        }
+        std::string path;
+        int end = i;
+        return this->path(end, path) && !findNative(this->tokens[end].symbol) && this->resolve(path) == 0 && !this->dynamic;
+    }
+
+    // Reads an operand of an arithmetic superinstruction. Numbers and strings become constants and a path is
+    // read when the instruction runs if late is set, everything else is compiled to a register.
+    uint32_t operand(int& i, bool late) {
+        if (this->is(i, Token::Number)) {
+            try {
+                return makeOperand(OPERAND_NUMBER, this->number(std::stod(std::string(this->tokens.value(i)))));
+            } catch (const std::exception& e) {
+                this->fail();
+                return 0;
+            }
+        }
+        if (this->is(i, Token::String)) {
+            return makeOperand(OPERAND_STRING, this->string(std::string(this->tokens.value(i))));
+        }
+        if (this->is(i, Token::Identifier)) {
+            ConfigEntry* value = this->parser->fold(this->tokens, i);
+            if (value) {
+                uint32_t operand = value->getType() == EntryType::String
+                    ? makeOperand(OPERAND_STRING, this->string(((StringEntry*) value)->getValue()))
+                    : makeOperand(OPERAND_NUMBER, this->number(((NumberEntry*) value)->getValue()));
+                delete value;
+                return operand;
+            }
+        }
+        if (late && this->constant(i)) {
+            std::string path;
+            this->path(i, path);
+            return makeOperand(OPERAND_PATH, this->scope(path));
+        }
+        return makeOperand(OPERAND_REGISTER, this->expr(i));
+    }
+
+    // Compiles the operands of an arithmetic native, or returns false without compiling anything if the call
+    // names its arguments.
+    bool arithOperands(int& i, Arith op, uint32_t& a, uint32_t& b) {
+        if (this->is(i + 1, Token::Assign)) {
+            return false;
+        }
+        i++;
+        if (isUnary(op)) {
+            a = this->operand(i, true);
+            b = 0;
+            return !this->failed;
+        }
+        // the first operand is only read late if nothing runs between it and the instruction
+        int second = i;
+        if (this->is(i, Token::Identifier) && !findBuiltin(this->tokens[i].symbol)) {
+            std::string path;
+            this->path(second, path);
+        }
+        second++;
+        bool late = this->constant(i) && !this->is(second, Token::Assign) && this->constant(second);
+        a = this->operand(i, late);
+        if (this->failed) {
+            return false;
+        }
+        i++;
+        if (this->is(i, Token::Assign)) {
+            return this->fail();
+        }
+        b = this->operand(i, true);
+        return !this->failed;
+    }
+
+    // Compiles a call of a pure native on constants to its value.
+    bool folded(int& i, uint32_t target) {
+        ConfigEntry* value = this->parser->fold(this->tokens, i);
+        if (!value) {
+            return false;
+        }
+        if (value->getType() == EntryType::String) {
+            this->emit(Op::String, i, target, this->string(((StringEntry*) value)->getValue()));
+        } else {
+            this->emit(Op::Number, i, target, this->number(((NumberEntry*) value)->getValue()));
+        }
+        delete value;
+        this->shape = Shape();
+        this->shape.kind = Shape::Value;
+        return true;
+    }
+
+    // Returns the index of the last token of the expression at i if it is a constant, a path to a value, a call
+    // of a pure native on such expressions or a block holding one of them, or -1. Adds the first names of its paths
+    // to heads and raises depth to the innermost scope that binds one of them.
+    int pure(int i, int& depth, std::vector<std::string>& heads) {
+        if (this->is(i, Token::Number) || this->is(i, Token::String)) {
+            return i;
+        }
+        if (this->is(i, Token::BlockStart)) {
+            int end = this->pure(i + 1, depth, heads);
+            return end >= 0 && this->is(end + 1, Token::BlockEnd) ? end + 1 : -1;
+        }
+        if (!this->is(i, Token::Identifier)) {
+            return -1;
+        }
+        std::string name(this->tokens.value(i));
+        if (findBuiltin(this->tokens[i].symbol)) {
+            return name == "true" || name == "false" ? i : -1;
+        }
+        int last = i;
+        std::string path;
+        if (!this->path(last, path)) {
+            return -1;
+        }
+        NativeFunctionEntry* native = findNative(this->tokens[last].symbol);
+        if (native) {
+            if (last != i || !native->isPure) {
+                return -1;
+            }
+            int end = i;
+            for (size_t n = 0; n < native->args.size(); n++) {
+                if (this->is(end + 1, Token::Assign)) {
+                    return -1;
+                }
+                end = this->pure(end + 1, depth, heads);
+                if (end < 0) {
+                    return -1;
+                }
+            }
+            return end;
+        }
+        if (this->resolve(path) != 0 || this->dynamic) {
+            return -1;
+        }
+        std::string head = path.substr(0, path.find('.'));
+        for (size_t s = this->scopes.size(); s > 0; s--) {
+            if (this->scopes[s - 1].count(head)) {
+                depth = std::max(depth, (int) s - 1);
+                break;
+            }
+        }
+        heads.push_back(head);
+        return last;
+    }
+
+    // True if the tokens from i to end appear again later in the block.
+    bool repeats(int i, int end) {
+        int length = end - i + 1;
+        int last = (int) this->tokens.blockEnd(this->base);
+        for (int at = end + 1; at + length <= last; at++) {
+            int k = 0;
+            while (k < length && this->tokens[at + k].type == this->tokens[i + k].type && this->tokens.value(at + k) == this->tokens.value(i + k)) {
+                k++;
+            }
+            if (k == length) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Compiles a call of a pure native on paths to values so that its value is kept in a slot, if it is computed
+    // more than once with the same names. Inside a loop the value is reused by the iterations after the first one,
+    // unless one of the names is bound by an iteration.
+    bool reuse(int& i, uint32_t target) {
+        if (!this->parser->optimize || this->keeping || this->is(i + 1, Token::Dot) || !findNative(this->tokens[i].symbol)) {
+            // loading a path costs as much as reusing its value
+            return false;
+        }
+        int depth = -1;
+        std::vector<std::string> heads;
+        int end = this->pure(i, depth, heads);
+        if (end < 0 || heads.empty() || this->failed) {
+            // a call on constants only is folded
+            return false;
+        }
+        // the outermost loop the names do not change in
+        int64_t home = -1;
+        if (!this->open.empty() && (int) this->open[0].scope <= depth) {
+            home = -2;
+            for (const OpenLoop& loop : this->open) {
+                if ((int) loop.scope > depth) {
+                    home = loop.loop;
+                    break;
+                }
+            }
+            if (home == -2) {
+                return false;
+            }
+        }
+        std::string key = std::to_string(home);
+        for (int k = i; k <= end; k++) {
+            key += " ";
+            key += std::to_string(this->tokens[k].type);
+            key += this->tokens.value(k);
+        }
+        auto found = this->kept.find(key);
+        bool repeated = found != this->kept.end();
+        if (!repeated && this->open.empty() && !this->repeats(i, end)) {
+            return false;
+        }
+        uint32_t slot = repeated ? found->second.slot : this->chunk->kept++;
+        if (repeated) {
+            this->parser->optimized(this->tokens, i, end, "reused");
+        } else if (!this->open.empty()) {
+            this->parser->optimized(this->tokens, i, end, "hoisted", " out of the loop");
+        }
+        int start = i;
+        size_t check = this->emit(Op::Reuse, start, target, slot);
+        this->keeping = true;
+        this->call(i, target);
+        this->keeping = false;
+        this->emit(Op::Keep, i, target, slot);
+        this->patch(check);
+        if (!repeated) {
+            this->kept[key] = {slot, home, heads};
+        }
+        return true;
+    }
+
+    void call(int& i, uint32_t target) {
+        int last = i;
+        std::string path;
+        if (!this->path(last, path)) {
+            return;
+        }
+        std::string name(this->tokens.value(last));
+        NativeFunctionEntry* native = findNative(this->tokens[last].symbol);
+        if (native) {
+            if (name == "use") {
+                // use merges a file into the stack, nothing can be assumed about the names after it
+                this->fail();
+                return;
+            }
+            auto arith = arithNatives.find(name);
+            int at = last;
+            uint32_t a, b;
+            if (arith != arithNatives.end() && this->arithOperands(at, arith->second, a, b)) {
+                uint32_t site = this->site({path, native, native->args.size(), std::vector<Symbol>(native->args.size())});
+                this->emit(Op::Arith, at, target, a, b, site, (uint8_t) arith->second);
+                i = at;
+                this->shape = Shape();
+                this->shape.kind = Shape::Value;
+                return;
+            }
+            if (this->failed) {
+                return;
+            }
+            i = last;
+            Site site{path, native, native->args.size(), {}};
+            if (!this->args(i, site.arity, site, &native->args)) {
+                return;
+            }
+            this->emit(Op::Native, i, target, this->site(site), target + 1);
+            this->shape = Shape();
+            return;
+        }
+        i = last;
+        auto found = this->overrides.find(last - this->base);
+        Site site{path, nullptr, found != this->overrides.end() ? found->second : this->resolve(path), {}};
+        if (site.arity == 0) {
+            this->emit(Op::Path, last, target, this->site(site));
+            this->shape = Shape();
+            return;
+        }
+        size_t lookup = this->emit(Op::Lookup, last, target);
+        if (!this->args(i, site.arity, site, nullptr)) {
+            return;
+        }
+        uint32_t index = this->site(site);
+        this->chunk->code[lookup].b = index;
+        this->emit(Op::Call, i, target, index, target + 1);
+        this->shape = Shape();
+    }
+};
+#pragma endregion
+
+#pragma region VM
+// A register. Numbers stay inline until something needs them as an entry, like a call, a list or the value of the
+// block, so arithmetic and comparisons allocate nothing. Everything else is an entry the register owns.
+struct Value {
+    enum Tag : uint8_t { Entry, Number } tag;
+    union {
+        ConfigEntry* entry;
+        double number;
+    };
+
+    void set(ConfigEntry* entry) {
+        this->tag = Entry;
+        this->entry = entry;
+    }
+
+    void set(double number) {
+        this->tag = Number;
+        this->number = number;
+    }
+
+    EntryType type() const {
+        return this->tag == Number ? EntryType::Number : this->entry->getType();
+    }
+
+    // Turns an inline number into an entry, which the register keeps until it is handed on.
+    ConfigEntry* box() {
+        if (this->tag == Number) {
+            NumberEntry* entry = new NumberEntry();
+            entry->setValue(this->number);
+            this->set(entry);
+        }
+        return this->entry;
+    }
+
+    void free() {
+        if (this->tag == Entry) {
+            delete this->entry;
+        }
+    }
+};
+static_assert(sizeof(Value) == 16, "a register is a tag and a word");
+
+struct Loop {
+    ListEntry* list;
+    size_t index;
+    ConfigEntry* result;
+    // parser->captures when the iteration started
+    uint64_t captures;
+};
+
+struct Handler {
+    uint32_t target;
+    size_t depth;
+};
+
+// The registers, loops and handlers of a run. They are kept when a call site finds a function with a different
+// arity, so the run can go on in a chunk compiled for it.
+struct State {
+    Value fixed[32];
+    std::vector<Value> heap;
+    Value* registers = fixed;
+    std::vector<Loop> loops;
+    std::vector<Handler> handlers;
+    // copies of the values kept in the slots of the chunk, nullptr until they are computed
+    std::vector<ConfigEntry*> kept;
+    // where the run stops or goes on
+    uint32_t pc = 0;
+    // the arity the call site at pc found
+    size_t arity = 0;
+
+    void reserve(const Chunk* chunk) {
+        if (chunk->registers > 32 && this->heap.size() < chunk->registers) {
+            bool fixed = this->registers == this->fixed;
+            this->heap.resize(chunk->registers);
+            if (fixed) {
+                std::copy(this->fixed, this->fixed + 32, this->heap.begin());
+            }
+            this->registers = this->heap.data();
+        }
+        if (this->loops.size() < chunk->loops) {
+            this->loops.resize(chunk->loops);
+        }
+        if (this->kept.size() < chunk->kept) {
+            this->kept.resize(chunk->kept);
+        }
+    }
+
+    // Empties the slots from first on.
+    void drop(size_t first, size_t count) {
+        for (size_t slot = first; slot < first + count && slot < this->kept.size(); slot++) {
+            delete this->kept[slot];
+            this->kept[slot] = nullptr;
+        }
+    }
+
+    ~State() {
+        this->drop(0, this->kept.size());
+    }
+};
+
+// Returned when a call site found a function with a different arity.
+static StringEntry deoptimized;
+// Returned by Frame::arith when it compared two strings without building entries.
+static StringEntry compared;
+
+// Binds the arguments of a call like parseArgs does. Positional arguments are already in the order the function
+// declares them, the registers are used as the frame as they are.
+static ConfigEntry** bindArgs(FunctionEntry* function, const Site& site, ConfigEntry** values, ArgFrame& frame, TokenList& tokens, int i) {
+    if (site.positional) {
+        for (size_t n = 0; n < function->args.size(); n++) {
+            const Type::CompoundType& declared = function->args[n];
+            if (!declared.type->validate(values[n], {})) {
+                LYNX_ERR << "Invalid argument type" << std::endl;
+                return nullptr;
+            }
+            values[n]->setKey(declared.key);
+        }
+        return values;
+    }
+    for (size_t n = 0; n < function->args.size(); n++) {
+        size_t position = site.names[n].empty() ? n : function->position(site.names[n]);
+        if (position == function->args.size()) {
+            LYNX_ERR << "Invalid argument name '" << site.names[n] << "'" << std::endl;
+            return nullptr;
+        }
+        if (!function->bindArg(tokens, i, position, values[n], frame.values)) {
+            return nullptr;
+        }
+    }
+    return frame.values;
+}
+
+// Loads a path like parsePath does: a value is cloned and a function without arguments is called.
+// A function with arguments returns &deoptimized and sets arity.
+static ConfigEntry* loadPath(ConfigParser* parser, ScopePath& path, std::vector<CompoundEntry*>& compoundStack, TokenList& tokens, int i, size_t& arity) {
+    ConfigEntry* entry = path.find(compoundStack);
+    if (!entry) {
+        LYNX_ERR << "Failed to find entry by path '" << path.path << "'" << std::endl;
+        return nullptr;
+    }
+    if (entry->getType() != EntryType::Function) {
+        return entry->clone();
+    }
+    if (!((FunctionEntry*) entry)->args.empty()) {
+        arity = ((FunctionEntry*) entry)->args.size();
+        return &deoptimized;
+    }
+    ConfigEntry* result = ((FunctionEntry*) entry)->invoke(parser, compoundStack, nullptr);
+    if (!result) {
+        LYNX_ERR << "Failed to run function" << std::endl;
+    }
+    return result;
+}
+
+static double compute(Arith op, double a, double b) {
+    switch (op) {
+        case Arith::Add: return a + b;
+        case Arith::Sub: return a - b;
+        case Arith::Mul: return a * b;
+        case Arith::Div: return a / b;
+        case Arith::Gt: return a > b;
+        case Arith::Lt: return a < b;
+        case Arith::Ge: return a >= b;
+        case Arith::Le: return a <= b;
+        case Arith::Or: return a || b;
+        case Arith::And: return a && b;
+        case Arith::Mod: return std::fmod(a, b);
+        case Arith::Eq: return a == b;
+        case Arith::Ne: return a != b;
+        case Arith::Not: return !a;
+        case Arith::Inc: return a + 1;
+        case Arith::Dec: return a - 1;
+    }
+    return 0;
+}
+
+struct Frame {
+    ConfigParser* parser;
+    Chunk* chunk;
+    TokenList& tokens;
+    int base;
+    std::vector<CompoundEntry*>& compoundStack;
+    Value* registers;
+
+    // Reads an operand as a number without allocating, false if it is not a number.
+    bool number(uint32_t operand, double& value) {
+        ConfigEntry* entry;
+        switch (operandKind(operand)) {
+            case OPERAND_NUMBER:
+                value = this->chunk->numbers[operandIndex(operand)];
+                return true;
+            case OPERAND_REGISTER: {
+                Value& known = this->registers[operandIndex(operand)];
+                if (known.tag == Value::Number) {
+                    value = known.number;
+                    return true;
+                }
+                entry = known.entry;
+                break;
+            }
+            case OPERAND_PATH:
+                entry = this->chunk->paths[operandIndex(operand)].find(this->compoundStack);
+                break;
+            default:
+                return false;
+        }
+        if (!entry || entry->getType() != EntryType::Number) {
+            return false;
+        }
+        value = ((NumberEntry*) entry)->getValue();
+        return true;
+    }
+
+    // Reads an operand as a string without copying it, nullptr if it is not a string.
+    const std::string* string(uint32_t operand) {
+        ConfigEntry* entry;
+        switch (operandKind(operand)) {
+            case OPERAND_STRING:
+                return &this->chunk->strings[operandIndex(operand)];
+            case OPERAND_REGISTER:
+                if (this->registers[operandIndex(operand)].tag == Value::Number) {
+                    return nullptr;
+                }
+                entry = this->registers[operandIndex(operand)].entry;
+                break;
+            case OPERAND_PATH:
+                entry = this->chunk->paths[operandIndex(operand)].find(this->compoundStack);
+                break;
+            default:
+                return nullptr;
+        }
+        if (!entry || entry->getType() != EntryType::String) {
+            return nullptr;
+        }
+        return &((StringEntry*) entry)->getValue();
+    }
+
+    // Frees the value of a register operand once the instruction has read it. Registers only hold values that were
+    // just computed for the instruction that reads them.
+    void consume(uint32_t operand) {
+        if (operandKind(operand) == OPERAND_REGISTER) {
+            this->registers[operandIndex(operand)].free();
+        }
+    }
+
+    // Turns an operand into an entry to pass to the native function.
+    ConfigEntry* entry(uint32_t operand, int i) {
+        switch (operandKind(operand)) {
+            case OPERAND_REGISTER: return this->registers[operandIndex(operand)].box();
+            case OPERAND_NUMBER: {
+                NumberEntry* entry = new NumberEntry();
+                entry->setValue(this->chunk->numbers[operandIndex(operand)]);
+                return entry;
+            }
+            case OPERAND_STRING: {
+                StringEntry* entry = new StringEntry();
+                entry->setValue(this->chunk->strings[operandIndex(operand)]);
+                return entry;
+            }
+            default: {
+                size_t arity;
+                return loadPath(this->parser, this->chunk->paths[operandIndex(operand)], this->compoundStack, this->tokens, i, arity);
+            }
+        }
+    }
+
+    // Runs an arithmetic native on operands that are not both numbers. Strings are compared inline, anything
+    // else goes through the native function so results and errors stay the same.
+    // Returns &compared with truth set, the result of the native, nullptr on error or &deoptimized.
+    ConfigEntry* arith(const Instruction* pc, const Site& site, bool& truth) {
+        Arith op = (Arith) pc->sub;
+        if (op == Arith::Eq || op == Arith::Ne) {
+            const std::string* a = this->string(pc->b);
+            const std::string* b = a ? this->string(pc->c) : nullptr;
+            if (b) {
+                truth = (*a == *b) == (op == Arith::Eq);
+                return &compared;
+            }
+        }
+        int i = this->base + pc->token;
+        Value values[2];
+        values[0].set(this->entry(pc->b, i));
+        if (!values[0].entry || values[0].entry == &deoptimized) {
+            return values[0].entry;
+        }
+        if (!isUnary(op)) {
+            values[1].set(this->entry(pc->c, i));
+            if (!values[1].entry || values[1].entry == &deoptimized) {
+                return values[1].entry;
+            }
+        }
+        return this->invoke(site.native, site, values, i);
+    }
+
+    // Calls a function with the values of consecutive registers, which are handed on as entries.
+    ConfigEntry* invoke(FunctionEntry* function, const Site& site, Value* values, int i) {
+        TokenList& tokens = this->tokens;
+        ArgFrame boxed(function->args.size());
+        for (size_t n = 0; n < function->args.size(); n++) {
+            boxed.values[n] = values[n].box();
+        }
+        ArgFrame frame(site.positional ? 0 : function->args.size());
+        ConfigEntry** args = bindArgs(function, site, boxed.values, frame, tokens, i);
+        if (!args) {
+            return nullptr;
+        }
+        ConfigEntry* result = function->invoke(this->parser, this->compoundStack, args);
+        if (!result) {
+            LYNX_ERR << "Failed to run function" << std::endl;
+        }
+        return result;
+    }
+};
+
+// Runs a chunk compiled from the block at base from state.pc on. Returns its value, nullptr on error or
+// &deoptimized with state.pc on the call site.
+static ConfigEntry* run(ConfigParser* parser, Chunk* chunk, TokenList& tokens, int base, std::vector<CompoundEntry*>& compoundStack, State& state) {
+#ifdef LYNX_VM_THREADED
+#define OP_LABEL(_name) &&op_##_name,
+    static const void* labels[] = { LYNX_OPS(OP_LABEL) };
+#undef OP_LABEL
+    if (!chunk->threaded) {
+        for (Instruction& instruction : chunk->code) {
+            instruction.handler = labels[(size_t) instruction.op];
+        }
+        chunk->threaded = true;
+    }
+#define CASE(_name) op_##_name:
+#define DISPATCH() goto *pc->handler
+#else
+#define CASE(_name) case Op::_name:
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT() do { pc++; DISPATCH(); } while (0)
+#define JUMP(_target) do { pc = code + (_target); DISPATCH(); } while (0)
+#define R(_r) registers[_r]
+
+#define DEOPTIMIZE(_arity) do { state.pc = pc - code; state.arity = (_arity); return &deoptimized; } while (0)
+
+    Value* registers = state.registers;
+    std::vector<Loop>& loops = state.loops;
+    std::vector<Handler>& handlers = state.handlers;
+    Frame frame{parser, chunk, tokens, base, compoundStack, registers};
+    const Instruction* code = chunk->code.data();
+    const Instruction* pc = code + state.pc;
+
+#ifdef LYNX_VM_THREADED
+    DISPATCH();
+#else
+dispatch:
+    switch (pc->op) {
+#endif
+    CASE(String) {
+        StringEntry* entry = new StringEntry();
+        entry->setValue(chunk->strings[pc->b]);
+        R(pc->a).set(entry);
+        NEXT();
+    }
+    CASE(Number) {
+        R(pc->a).set(chunk->numbers[pc->b]);
+        NEXT();
+    }
+    CASE(EmptyString) {
+        R(pc->a).set(new StringEntry());
+        NEXT();
+    }
+    CASE(Path) {
+        size_t arity;
+        ConfigEntry* entry = loadPath(parser, chunk->sites[pc->b].path, compoundStack, tokens, base + pc->token, arity);
+        if (!entry) goto fail;
+        if (entry == &deoptimized) DEOPTIMIZE(arity);
+        R(pc->a).set(entry);
+        NEXT();
+    }
+    CASE(This) {
+        R(pc->a).set(compoundStack.back()->clone());
+        NEXT();
+    }
+    CASE(Lookup) {
+        Site& site = chunk->sites[pc->b];
+        ConfigEntry* entry = site.path.find(compoundStack);
+        if (!entry) {
+            VM_ERR << "Failed to find entry by path '" << site.path.path << "'" << std::endl;
+            goto fail;
+        }
+        if (arityOf(entry) != site.arity) DEOPTIMIZE(arityOf(entry));
+        // functions are only called, never changed
+        R(pc->a).set(entry->getType() == EntryType::Function ? entry : entry->clone());
+        NEXT();
+    }
+    CASE(Call) {
+        ConfigEntry* entry = frame.invoke((FunctionEntry*) R(pc->a).entry, chunk->sites[pc->b], registers + pc->c, base + pc->token);
+        if (!entry) goto fail;
+        R(pc->a).set(entry);
+        NEXT();
+    }
+    CASE(Native) {
+        const Site& site = chunk->sites[pc->b];
+        ConfigEntry* entry = frame.invoke(site.native, site, registers + pc->c, base + pc->token);
+        if (!entry) goto fail;
+        R(pc->a).set(entry);
+        NEXT();
+    }
+    CASE(Arith) {
+        Arith op = (Arith) pc->sub;
+        double a, b = 0;
+        if (frame.number(pc->b, a) && (isUnary(op) || frame.number(pc->c, b))) {
+            frame.consume(pc->b);
+            if (!isUnary(op)) frame.consume(pc->c);
+            R(pc->a).set(compute(op, a, b));
+            NEXT();
+        }
+        bool truth;
+        ConfigEntry* entry = frame.arith(pc, chunk->sites[pc->d], truth);
+        if (!entry) goto fail;
+        if (entry == &deoptimized) DEOPTIMIZE(0);
+        if (entry == &compared) {
+            frame.consume(pc->b);
+            frame.consume(pc->c);
+            R(pc->a).set(truth ? 1.0 : 0.0);
+            NEXT();
+        }
+        R(pc->a).set(entry);
+        NEXT();
+    }
+    CASE(BranchArith) {
+        Arith op = (Arith) pc->sub;
+        double a, b = 0;
+        if (frame.number(pc->b, a) && (isUnary(op) || frame.number(pc->c, b))) {
+            frame.consume(pc->b);
+            if (!isUnary(op)) frame.consume(pc->c);
+            if (compute(op, a, b) != 0) NEXT();
+            JUMP(pc->d);
+        }
+        bool truth;
+        ConfigEntry* entry = frame.arith(pc, chunk->sites[pc->a], truth);
+        if (!entry) goto fail;
+        if (entry == &deoptimized) DEOPTIMIZE(0);
+        if (entry == &compared) {
+            frame.consume(pc->b);
+            frame.consume(pc->c);
+        } else {
+            if (entry->getType() != EntryType::Number) {
+                VM_ERR << "Invalid entry type. Expected Number but got " << entry->getType() << std::endl;
+                entry->print(std::cerr);
+                goto fail;
+            }
+            truth = ((NumberEntry*) entry)->getValue() != 0;
+            delete entry;
+        }
+        if (truth) NEXT();
+        JUMP(pc->d);
+    }
+    CASE(Branch) {
+        if (R(pc->a).tag == Value::Number) {
+            if (R(pc->a).number != 0) NEXT();
+            JUMP(pc->d);
+        }
+        ConfigEntry* entry = R(pc->a).entry;
+        if (entry->getType() != EntryType::Number) {
+            VM_ERR << "Invalid entry type. Expected Number but got " << entry->getType() << std::endl;
+            entry->print(std::cerr);
+            goto fail;
+        }
+        bool truth = ((NumberEntry*) entry)->getValue() != 0;
+        delete entry;
+        if (truth) NEXT();
+        JUMP(pc->d);
+    }
+    CASE(Jump) {
+        JUMP(pc->d);
+    }
+    CASE(BlockAdd) {
+        if (R(pc->a).tag == Value::Number && R(pc->b).tag == Value::Number) {
+            R(pc->a).number += R(pc->b).number;
+            NEXT();
+        }
+        R(pc->a).box();
+        if (!addBlockEntry(R(pc->a).entry, R(pc->b).box(), tokens, base + pc->token)) goto fail;
+        NEXT();
+    }
+    CASE(List) {
+        R(pc->a).set(new ListEntry());
+        NEXT();
+    }
+    CASE(ListAdd) {
+        ListEntry* list = (ListEntry*) R(pc->a).entry;
+        ConfigEntry* entry = R(pc->b).box();
+        if (list->getListType() == EntryType::Invalid) {
+            list->setListType(entry->getType());
+        } else if (list->getListType() != entry->getType()) {
+            VM_ERR << "Invalid entry type in list. Expected " << list->getListType() << " but got " << entry->getType() << std::endl;
+            goto fail;
+        }
+        entry->setKey("");
+        list->add(entry);
+        NEXT();
+    }
+    CASE(Compound) {
+        CompoundEntry* compound = new CompoundEntry();
+        compound->reserve(pc->b);
+        compoundStack.push_back(compound);
+        R(pc->a).set(compound);
+        NEXT();
+    }
+    CASE(CompoundType) {
+        CompoundEntry* compound = (CompoundEntry*) R(pc->a).entry;
+        Symbol key = chunk->symbols[pc->b];
+        int at = base + pc->c;
+        Type* type = parser->parseType(tokens, at, compoundStack);
+        if (!type) {
+            VM_ERR << "Failed to parse type for key '" << key << "'" << std::endl;
+            goto fail;
+        }
+        TypeEntry* entry = new TypeEntry();
+        entry->type = type;
+        entry->setKey(key);
+        ConfigEntry* current = compound->get(key);
+        if (current && current->getType() == EntryType::Type) {
+            VM_ERR << "Type entry already exists for key '" << key << "'" << std::endl;
+            goto fail;
+        } else if (current) {
+            VM_ERR << "Assigning type to existing entry for key '" << key << "' has no effect" << std::endl;
+        }
+        compound->add(entry);
+        NEXT();
+    }
+    CASE(CompoundSet) {
+        CompoundEntry* compound = (CompoundEntry*) R(pc->a).entry;
+        Symbol key = chunk->symbols[pc->b];
+        ConfigEntry* entry = R(pc->c).box();
+        entry->setKey(key);
+        ConfigEntry* current = compound->get(key);
+        if (current && current->getType() == EntryType::Type && !((TypeEntry*) current)->validate(entry, {}, std::cerr)) {
+            VM_ERR << "Invalid entry type for key '" << key << "'" << std::endl;
+            goto fail;
+        }
+        compound->add(entry);
+        NEXT();
+    }
+    CASE(CompoundEnd) {
+        compoundStack.pop_back();
+        NEXT();
+    }
+    CASE(Func) {
+        const FunctionProto& proto = chunk->functions[pc->b];
+        DeclaredFunctionEntry* entry = new DeclaredFunctionEntry();
+        for (auto& arg : proto.args) {
+            int at = base + arg.second;
+            Type* type = parser->parseType(tokens, at, compoundStack);
+            if (!type) {
+                VM_ERR << "Failed to parse type for argument '" << arg.first << "'" << std::endl;
+                goto fail;
+            }
+            entry->args.push_back({arg.first, type});
+        }
+        entry->body = tokens.slice(base + proto.bodyStart, base + proto.bodyEnd + 1);
+        entry->compoundStack = compoundStack;
+        parser->captures++;
+        R(pc->a).set(entry);
+        NEXT();
+    }
+    CASE(ForBegin) {
+        if (R(pc->a).type() != EntryType::List) {
+            VM_ERR << "Invalid entry type. Expected List but got " << R(pc->a).type() << std::endl;
+            goto fail;
+        }
+        Loop& loop = loops[pc->b];
+        loop.list = (ListEntry*) R(pc->a).entry;
+        loop.index = 0;
+        loop.result = nullptr;
+        state.drop(pc->c, pc->d);
+        NEXT();
+    }
+    CASE(ForNext) {
+        Loop& loop = loops[pc->b];
+        if (loop.index >= loop.list->size()) JUMP(pc->d);
+        // the values may be shared with other lists, so the loop variable is a copy
+        ConfigEntry* value = loop.list->get(loop.index)->clone();
+        value->setKey(chunk->symbols[pc->c]);
+        CompoundEntry* compound = new CompoundEntry();
+        compoundStack.push_back(compound);
+        compound->add(value);
+        loop.captures = parser->captures;
+        NEXT();
+    }
+    CASE(ForStep) {
+        Loop& loop = loops[pc->b];
+        Value& next = R(pc->a);
+        CompoundEntry* compound = compoundStack.back();
+        compoundStack.pop_back();
+        if (parser->captures == loop.captures) {
+            delete compound;
+        }
+        if (!loop.result) {
+            loop.result = next.box();
+            if (loop.result->getType() == EntryType::List) {
+                // the body usually yields as many values every time
+                ((ListEntry*) loop.result)->reserve(((ListEntry*) loop.result)->size() * loop.list->size());
+            }
+        } else if (next.type() != loop.result->getType()) {
+            VM_ERR << "Invalid entry type in for loop block. Expected " << loop.result->getType() << " but got " << next.type() << std::endl;
+            goto fail;
+        } else if (next.tag == Value::Number) {
+            ((NumberEntry*) loop.result)->setValue(((NumberEntry*) loop.result)->getValue() + next.number);
+        } else if (!sumEntries(loop.result, next.entry)) {
+            goto fail;
+        } else {
+            delete next.entry;
+        }
+        loop.index++;
+        JUMP(pc->d);
+    }
+    CASE(ForEnd) {
+        Loop& loop = loops[pc->b];
+        R(pc->a).set(loop.result ? loop.result : new StringEntry());
+        state.drop(pc->c, pc->d);
+        NEXT();
+    }
+    CASE(Match) {
+        if (R(pc->a).tag == Value::Number && R(pc->b).tag == Value::Number) {
+            if (R(pc->a).number == R(pc->b).number) JUMP(pc->d);
+            NEXT();
+        }
+        ConfigEntry* value = R(pc->a).box();
+        ConfigEntry* caseValue = R(pc->b).box();
+        if (caseValue->getType() == value->getType() && caseValue->operator==(*value)) JUMP(pc->d);
+        NEXT();
+    }
+    CASE(NoMatch) {
+        VM_ERR << "No matching case found" << std::endl;
+        goto fail;
+    }
+    CASE(Exists) {
+        R(pc->a).set(chunk->paths[pc->b].find(compoundStack) ? 1.0 : 0.0);
+        NEXT();
+    }
+    CASE(Set) {
+        ConfigEntry* binding = R(pc->a).box()->clone();
+        binding->setKey(chunk->symbols[pc->b]);
+        compoundStack.back()->add(binding);
+        parser->effects++;
+        NEXT();
+    }
+    CASE(Try) {
+        handlers.push_back({pc->d, compoundStack.size()});
+        NEXT();
+    }
+    CASE(EndTry) {
+        handlers.pop_back();
+        NEXT();
+    }
+    CASE(Reuse) {
+        ConfigEntry* value = state.kept[pc->b];
+        if (value) {
+            if (value->getType() == EntryType::Number) {
+                R(pc->a).set(((NumberEntry*) value)->getValue());
+            } else {
+                R(pc->a).set(value->clone());
+            }
+            JUMP(pc->d);
+        }
+        NEXT();
+    }
+    CASE(Keep) {
+        ConfigEntry*& value = state.kept[pc->b];
+        delete value;
+        if (R(pc->a).tag == Value::Number) {
+            NumberEntry* number = new NumberEntry();
+            number->setValue(R(pc->a).number);
+            value = number;
+        } else {
+            value = R(pc->a).entry->clone();
+        }
+        NEXT();
+    }
+    CASE(Return) {
+        return R(pc->a).box();
+    }
+#ifndef LYNX_VM_THREADED
+    }
+#endif
+
+fail:
+    if (!handlers.empty()) {
+        Handler handler = handlers.back();
+        handlers.pop_back();
+        compoundStack.resize(handler.depth);
+        JUMP(handler.target);
+    }
+    return nullptr;
+
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef R
+#undef DEOPTIMIZE
+}
+#pragma endregion
+
+// Runs a block on the VM, or with the nodes if it cannot be compiled.
+struct BytecodeNode : public Node {
+    Chunk* chunk = nullptr;
+    // chunks that were replaced, a recursive call may still be running one of them
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    std::unique_ptr<Node> fallback;
+    std::unordered_map<int32_t, size_t> overrides;
+    size_t resumes = 0;
+
+    bool guardsHold(std::vector<CompoundEntry*>& compoundStack) {
+        for (Guard& guard : this->chunk->guards) {
+            if (arityOf(guard.path.find(compoundStack)) != guard.arity) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Compiles the block, keeping the arities of free names from the previous chunk if keep is set.
+    bool compile(ConfigParser* parser, TokenList& tokens, int i, std::vector<CompoundEntry*>& compoundStack, bool keep) {
+        Chunk* chunk = new Chunk();
+        this->chunks.emplace_back(chunk);
+        Compiler compiler(parser, tokens, compoundStack, chunk, i, this->overrides);
+        if (keep && this->chunk) {
+            for (const Guard& guard : this->chunk->guards) {
+                compiler.previous[guard.path.path] = guard.arity;
+            }
+        }
+        int end = i;
+        uint32_t result = compiler.expr(end);
+        compiler.emit(Op::Return, end, result);
+        if (compiler.failed) {
+            return false;
+        }
+        chunk->length = end - i;
+        this->chunk = chunk;
+        return true;
+    }
+
+    // Recompiles the block for the arity the call site at state.pc found. Everything before the call site compiles
+    // to the same code, so the run goes on from the same instruction.
+    bool resume(ConfigParser* parser, TokenList& tokens, int i, std::vector<CompoundEntry*>& compoundStack, State& state) {
+        const Instruction& site = this->chunk->code[state.pc];
+        if (site.op != Op::Lookup && site.op != Op::Path) {
+            return false;
+        }
+        this->overrides[site.token] = state.arity;
+        this->resumes++;
+        // the new chunk may keep other values in the same slots
+        state.drop(0, state.kept.size());
+        if (!this->compile(parser, tokens, i, compoundStack, true)) {
+            return false;
+        }
+        const std::vector<Instruction>& code = this->chunk->code;
+        if (state.pc >= code.size() || code[state.pc].token != site.token || (code[state.pc].op != Op::Lookup && code[state.pc].op != Op::Path)) {
+            return false;
+        }
+        state.reserve(this->chunk);
+        return true;
+    }
+
+    ConfigEntry* evalNodes(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) {
+        this->chunk = nullptr;
+        this->fallback.reset(parser->compile(tokens, i));
+        return this->fallback->eval(parser, tokens, i, compoundStack);
+    }
+
+    ConfigEntry* eval(ConfigParser* parser, TokenList& tokens, int& i, std::vector<CompoundEntry*>& compoundStack) override {
+        if (this->fallback) {
+            return this->fallback->eval(parser, tokens, i, compoundStack);
+        }
+        if (this->chunk && (!tokens.has(i + this->chunk->length) || tokens.blockEnd(i) != (size_t) (i + this->chunk->length))) {
+            // a slice that cuts the block short
+            return parser->parseBlock(tokens, i, compoundStack);
+        }
+        if (this->resumes > 16) {
+            // call sites that keep changing, the nodes handle them better
+            return this->evalNodes(parser, tokens, i, compoundStack);
+        }
+        if (!this->chunk || !this->guardsHold(compoundStack)) {
+            this->overrides.clear();
+            if (!this->compile(parser, tokens, i, compoundStack, false)) {
+                return this->evalNodes(parser, tokens, i, compoundStack);
+            }
+        }
+        State state;
+        state.reserve(this->chunk);
+        size_t depth = compoundStack.size();
+        uint64_t effects = parser->effects;
+        ConfigEntry* result = run(parser, this->chunk, tokens, i, compoundStack, state);
+        while (result == &deoptimized) {
+            if (!this->resume(parser, tokens, i, compoundStack, state)) {
+                compoundStack.resize(depth);
+                if (parser->effects != effects) {
+                    LYNX_ERR << "A function called in this block changed while it was running" << std::endl;
+                    return nullptr;
+                }
+                return this->evalNodes(parser, tokens, i, compoundStack);
+            }
+            result = run(parser, this->chunk, tokens, i, compoundStack, state);
+        }
+        if (!result) {
+            compoundStack.resize(depth);
+            return nullptr;
+        }
+        i += this->chunk->length;
+        return result;
+    }
+};
+
+Node* ConfigParser::compileBytecode(TokenList& tokens, int i) {
+    return new BytecodeNode();
+}